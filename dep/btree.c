@@ -0,0 +1,536 @@
+#include "btree.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Entries are ordered by expire, then by member address. Members are never
+ * dereferenced, they may already have been released when a prefix is dropped. */
+static inline int m_btreeCompare(long long e1, RedisModuleString *m1, long long e2, RedisModuleString *m2) {
+    if (e1 != e2) {
+        return e1 < e2 ? -1 : 1;
+    }
+    return (uintptr_t)m1 < (uintptr_t)m2 ? -1 : ((uintptr_t)m1 > (uintptr_t)m2);
+}
+
+static size_t m_btreeLeafSize(unsigned int cap) {
+    return sizeof(m_btreeLeaf) + cap * (sizeof(long long) + sizeof(RedisModuleString *));
+}
+
+/* The arrays of a leaf live in the same allocation, right after the header. */
+static void m_btreeLeafSetArrays(m_btreeLeaf *leaf) {
+    leaf->expires = (long long *)(leaf + 1);
+    leaf->members = (RedisModuleString **)(leaf->expires + leaf->cap);
+}
+
+static m_btreeLeaf *m_btreeCreateLeaf(m_btree *t, unsigned int cap) {
+    m_btreeLeaf *leaf = RedisModule_Alloc(m_btreeLeafSize(cap));
+    leaf->prev = leaf->next = NULL;
+    leaf->count = 0;
+    leaf->cap = cap;
+    m_btreeLeafSetArrays(leaf);
+    t->alloc_size += m_btreeLeafSize(cap);
+    return leaf;
+}
+
+static void m_btreeFreeLeaf(m_btree *t, m_btreeLeaf *leaf) {
+    t->alloc_size -= m_btreeLeafSize(leaf->cap);
+    RedisModule_Free(leaf);
+}
+
+static m_btreeInner *m_btreeCreateInner(m_btree *t) {
+    m_btreeInner *inner = RedisModule_Alloc(sizeof(*inner));
+    inner->count = 0;
+    t->alloc_size += sizeof(*inner);
+    return inner;
+}
+
+static void m_btreeFreeInner(m_btree *t, m_btreeInner *inner) {
+    t->alloc_size -= sizeof(*inner);
+    RedisModule_Free(inner);
+}
+
+/* Unlink an empty leaf from the leaf chain and free it. */
+static void m_btreeDropLeaf(m_btree *t, m_btreeLeaf *leaf) {
+    if (leaf->prev) {
+        leaf->prev->next = leaf->next;
+    } else {
+        t->head = leaf->next;
+    }
+    if (leaf->next) {
+        leaf->next->prev = leaf->prev;
+    } else {
+        t->tail = leaf->prev;
+    }
+    m_btreeFreeLeaf(t, leaf);
+}
+
+m_btree *m_btreeCreate(void) {
+    m_btree *t = RedisModule_Alloc(sizeof(*t));
+    t->root = NULL;
+    t->height = 0;
+    t->length = 0;
+    t->alloc_size = 0;
+    t->head = t->tail = NULL;
+    return t;
+}
+
+static void m_btreeFreeNode(m_btree *t, void *node, int height) {
+    if (height == 0) {
+        m_btreeFreeLeaf(t, node);
+        return;
+    }
+    m_btreeInner *inner = node;
+    for (unsigned int i = 0; i < inner->count; i++) {
+        m_btreeFreeNode(t, inner->children[i], height - 1);
+    }
+    m_btreeFreeInner(t, inner);
+}
+
+void m_btreeFree(m_btree *t) {
+    if (t->root) {
+        m_btreeFreeNode(t, t->root, t->height);
+    }
+    RedisModule_Free(t);
+}
+
+/* Index of the child that covers the entry: the number of separators <= entry.
+ * Separator i is <= every entry of child i + 1 and > every entry of child i. */
+static unsigned int m_btreeInnerFind(m_btreeInner *inner, long long expire, RedisModuleString *member) {
+    unsigned int lo = 0, hi = inner->count - 1;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if (m_btreeCompare(inner->expires[mid], inner->members[mid], expire, member) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Position of the first entry of the leaf which is >= the given entry. */
+static unsigned int m_btreeLeafFind(m_btreeLeaf *leaf, long long expire, RedisModuleString *member) {
+    unsigned int lo = 0, hi = leaf->count;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if (m_btreeCompare(leaf->expires[mid], leaf->members[mid], expire, member) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void m_btreeLeafInsertAt(m_btreeLeaf *leaf, unsigned int pos, long long expire, RedisModuleString *member) {
+    memmove(leaf->expires + pos + 1, leaf->expires + pos, (leaf->count - pos) * sizeof(long long));
+    memmove(leaf->members + pos + 1, leaf->members + pos, (leaf->count - pos) * sizeof(RedisModuleString *));
+    leaf->expires[pos] = expire;
+    leaf->members[pos] = member;
+    leaf->count++;
+}
+
+/* Insert into the subtree rooted at `node`, if the node is split the new right
+ * sibling is returned and its smallest entry is stored in `sep_expire/sep_member`. */
+static void *m_btreeInsertNode(m_btree *t, void *node, int height, long long expire, RedisModuleString *member,
+                               long long *sep_expire, RedisModuleString **sep_member) {
+    if (height == 0) {
+        m_btreeLeaf *leaf = node;
+        unsigned int pos = m_btreeLeafFind(leaf, expire, member);
+        if (leaf->count < leaf->cap) {
+            m_btreeLeafInsertAt(leaf, pos, expire, member);
+            return NULL;
+        }
+
+        /* Expires mostly grow, so an append to the last leaf starts a new leaf and keeps
+         * the full one as it is instead of leaving two half empty leaves behind. */
+        unsigned int split = (leaf == t->tail && pos == leaf->count) ? leaf->count : leaf->count / 2;
+        m_btreeLeaf *right = m_btreeCreateLeaf(t, M_BTREE_LEAF_CAP);
+        right->count = leaf->count - split;
+        memcpy(right->expires, leaf->expires + split, right->count * sizeof(long long));
+        memcpy(right->members, leaf->members + split, right->count * sizeof(RedisModuleString *));
+        leaf->count = split;
+
+        right->prev = leaf;
+        right->next = leaf->next;
+        if (leaf->next) {
+            leaf->next->prev = right;
+        } else {
+            t->tail = right;
+        }
+        leaf->next = right;
+
+        if (right->count == 0 || pos > split) {
+            m_btreeLeafInsertAt(right, pos - split, expire, member);
+        } else {
+            m_btreeLeafInsertAt(leaf, pos, expire, member);
+        }
+        *sep_expire = right->expires[0];
+        *sep_member = right->members[0];
+        return right;
+    }
+
+    m_btreeInner *inner = node;
+    unsigned int i = m_btreeInnerFind(inner, expire, member);
+    long long child_expire;
+    RedisModuleString *child_member;
+    void *child_right = m_btreeInsertNode(t, inner->children[i], height - 1, expire, member, &child_expire, &child_member);
+    if (child_right == NULL) {
+        return NULL;
+    }
+
+    if (inner->count < M_BTREE_FANOUT) {
+        memmove(inner->expires + i + 1, inner->expires + i, (inner->count - 1 - i) * sizeof(long long));
+        memmove(inner->members + i + 1, inner->members + i, (inner->count - 1 - i) * sizeof(RedisModuleString *));
+        memmove(inner->children + i + 2, inner->children + i + 1, (inner->count - 1 - i) * sizeof(void *));
+        inner->expires[i] = child_expire;
+        inner->members[i] = child_member;
+        inner->children[i + 1] = child_right;
+        inner->count++;
+        return NULL;
+    }
+
+    /* Split a full inner node, the same append rule as for leaves applies. */
+    long long expires[M_BTREE_FANOUT];
+    RedisModuleString *members[M_BTREE_FANOUT];
+    void *children[M_BTREE_FANOUT + 1];
+    unsigned int n = inner->count, j, k = 0;
+    for (j = 0; j < n; j++) {
+        children[k++] = inner->children[j];
+        if (j == i) {
+            children[k++] = child_right;
+        }
+    }
+    for (j = 0, k = 0; j < n - 1; j++) {
+        if (j == i) {
+            expires[k] = child_expire;
+            members[k++] = child_member;
+        }
+        expires[k] = inner->expires[j];
+        members[k++] = inner->members[j];
+    }
+    if (i == n - 1) {
+        expires[k] = child_expire;
+        members[k++] = child_member;
+    }
+
+    /* `left` children stay in this node, separator left - 1 moves up. */
+    unsigned int total = n + 1;
+    unsigned int left = i == n - 1 ? n : total / 2;
+    m_btreeInner *right = m_btreeCreateInner(t);
+    inner->count = left;
+    memcpy(inner->children, children, left * sizeof(void *));
+    memcpy(inner->expires, expires, (left - 1) * sizeof(long long));
+    memcpy(inner->members, members, (left - 1) * sizeof(RedisModuleString *));
+    right->count = total - left;
+    memcpy(right->children, children + left, right->count * sizeof(void *));
+    memcpy(right->expires, expires + left, (right->count - 1) * sizeof(long long));
+    memcpy(right->members, members + left, (right->count - 1) * sizeof(RedisModuleString *));
+    *sep_expire = expires[left - 1];
+    *sep_member = members[left - 1];
+    return right;
+}
+
+void m_btreeInsert(m_btree *t, long long expire, RedisModuleString *member) {
+    t->length++;
+    if (t->root == NULL) {
+        m_btreeLeaf *leaf = m_btreeCreateLeaf(t, M_BTREE_LEAF_MIN_CAP);
+        t->root = t->head = t->tail = leaf;
+        t->height = 0;
+    } else if (t->height == 0) {
+        /* Small trees keep a single leaf which grows up to a full leaf. */
+        m_btreeLeaf *leaf = t->root;
+        if (leaf->count == leaf->cap && leaf->cap < M_BTREE_LEAF_CAP) {
+            size_t old_size = m_btreeLeafSize(leaf->cap);
+            unsigned int cap = leaf->cap * 2 > M_BTREE_LEAF_CAP ? M_BTREE_LEAF_CAP : leaf->cap * 2;
+            m_btreeLeaf *grown = RedisModule_Alloc(m_btreeLeafSize(cap));
+            grown->prev = grown->next = NULL;
+            grown->count = leaf->count;
+            grown->cap = cap;
+            m_btreeLeafSetArrays(grown);
+            memcpy(grown->expires, leaf->expires, leaf->count * sizeof(long long));
+            memcpy(grown->members, leaf->members, leaf->count * sizeof(RedisModuleString *));
+            RedisModule_Free(leaf);
+            t->alloc_size += m_btreeLeafSize(cap) - old_size;
+            t->root = t->head = t->tail = grown;
+        }
+    }
+
+    long long sep_expire;
+    RedisModuleString *sep_member;
+    void *right = m_btreeInsertNode(t, t->root, t->height, expire, member, &sep_expire, &sep_member);
+    if (right) {
+        m_btreeInner *root = m_btreeCreateInner(t);
+        root->count = 2;
+        root->children[0] = t->root;
+        root->children[1] = right;
+        root->expires[0] = sep_expire;
+        root->members[0] = sep_member;
+        t->root = root;
+        t->height++;
+    }
+}
+
+/* Remove child `i` of an inner node together with the separator bounding it. */
+static void m_btreeInnerRemoveChild(m_btreeInner *inner, unsigned int i) {
+    unsigned int sep = i > 0 ? i - 1 : 0;
+    if (inner->count > 1) {
+        memmove(inner->expires + sep, inner->expires + sep + 1, (inner->count - 2 - sep) * sizeof(long long));
+        memmove(inner->members + sep, inner->members + sep + 1, (inner->count - 2 - sep) * sizeof(RedisModuleString *));
+    }
+    memmove(inner->children + i, inner->children + i + 1, (inner->count - 1 - i) * sizeof(void *));
+    inner->count--;
+}
+
+/* Nodes are only removed once they are empty, separators left behind by deletions
+ * are still valid bounds. Sets `*emptied` if the node has to be removed by the caller. */
+static int m_btreeDeleteNode(m_btree *t, void *node, int height, long long expire, RedisModuleString *member, int *emptied) {
+    if (height == 0) {
+        m_btreeLeaf *leaf = node;
+        unsigned int pos = m_btreeLeafFind(leaf, expire, member);
+        if (pos == leaf->count || leaf->expires[pos] != expire || leaf->members[pos] != member) {
+            return 0;
+        }
+        memmove(leaf->expires + pos, leaf->expires + pos + 1, (leaf->count - pos - 1) * sizeof(long long));
+        memmove(leaf->members + pos, leaf->members + pos + 1, (leaf->count - pos - 1) * sizeof(RedisModuleString *));
+        leaf->count--;
+        *emptied = leaf->count == 0;
+        return 1;
+    }
+
+    m_btreeInner *inner = node;
+    unsigned int i = m_btreeInnerFind(inner, expire, member);
+    int child_emptied = 0;
+    if (!m_btreeDeleteNode(t, inner->children[i], height - 1, expire, member, &child_emptied)) {
+        return 0;
+    }
+    if (child_emptied) {
+        if (height == 1) {
+            m_btreeDropLeaf(t, inner->children[i]);
+        } else {
+            m_btreeFreeInner(t, inner->children[i]);
+        }
+        m_btreeInnerRemoveChild(inner, i);
+        *emptied = inner->count == 0;
+    }
+    return 1;
+}
+
+/* Drop the root while it is empty or an inner node with a single child. */
+static void m_btreeShrinkRoot(m_btree *t) {
+    if (t->length == 0 && t->root) {
+        m_btreeFreeNode(t, t->root, t->height);
+        t->root = NULL;
+        t->height = 0;
+        t->head = t->tail = NULL;
+        return;
+    }
+    while (t->height > 0 && ((m_btreeInner *)t->root)->count == 1) {
+        m_btreeInner *root = t->root;
+        t->root = root->children[0];
+        t->height--;
+        m_btreeFreeInner(t, root);
+    }
+}
+
+int m_btreeDelete(m_btree *t, long long expire, RedisModuleString *member) {
+    int emptied = 0;
+    if (t->root == NULL || !m_btreeDeleteNode(t, t->root, t->height, expire, member, &emptied)) {
+        return 0;
+    }
+    t->length--;
+    m_btreeShrinkRoot(t);
+    return 1;
+}
+
+void m_btreeUpdate(m_btree *t, long long cur_expire, RedisModuleString *member, long long new_expire) {
+    int deleted = m_btreeDelete(t, cur_expire, member);
+    assert(deleted);
+    m_btreeInsert(t, new_expire, member);
+}
+
+/* The leaf holding the first entry with an expire >= `expire` and its position in
+ * `*pos`, NULL if there is no such entry. */
+m_btreeLeaf *m_btreeSeek(m_btree *t, long long expire, unsigned int *pos) {
+    void *node = t->root;
+    if (node == NULL) {
+        return NULL;
+    }
+    for (int h = t->height; h > 0; h--) {
+        m_btreeInner *inner = node;
+        node = inner->children[m_btreeInnerFind(inner, expire, NULL)];
+    }
+    m_btreeLeaf *leaf = node;
+    *pos = m_btreeLeafFind(leaf, expire, NULL);
+    if (*pos == leaf->count) {
+        leaf = leaf->next;
+        *pos = 0;
+    }
+    return leaf;
+}
+
+/* Remove the first leaf of the tree, inner nodes left empty are removed too. */
+static void m_btreeDropHeadLeaf(m_btree *t) {
+    m_btreeInner *path[64];
+    void *node = t->root;
+    for (int h = t->height; h > 0; h--) {
+        path[h - 1] = node;
+        node = ((m_btreeInner *)node)->children[0];
+    }
+    t->length -= ((m_btreeLeaf *)node)->count;
+    m_btreeDropLeaf(t, node);
+    if (t->height == 0) {
+        t->root = NULL;
+        return;
+    }
+    for (int h = 0; h < t->height; h++) {
+        m_btreeInnerRemoveChild(path[h], 0);
+        if (path[h]->count) {
+            return;
+        }
+        if (h + 1 == t->height) {
+            t->root = NULL;
+            t->height = 0;
+        }
+        m_btreeFreeInner(t, path[h]);
+    }
+}
+
+/* Delete the `count` smallest entries: whole leaves are dropped without touching
+ * their entries, only the last partially expired leaf is shifted. Returns the number
+ * of deleted entries. */
+unsigned long m_btreeDeleteHead(m_btree *t, unsigned long count) {
+    unsigned long deleted = 0;
+    while (count && t->head) {
+        m_btreeLeaf *leaf = t->head;
+        if (leaf->count <= count) {
+            count -= leaf->count;
+            deleted += leaf->count;
+            m_btreeDropHeadLeaf(t);
+            continue;
+        }
+        memmove(leaf->expires, leaf->expires + count, (leaf->count - count) * sizeof(long long));
+        memmove(leaf->members, leaf->members + count, (leaf->count - count) * sizeof(RedisModuleString *));
+        leaf->count -= count;
+        t->length -= count;
+        deleted += count;
+        count = 0;
+    }
+    m_btreeShrinkRoot(t);
+    return deleted;
+}
+
+/* Build the tree bottom up from entries sorted by m_btreeSortEntries(), the tree must
+ * be empty. Leaves and inner nodes are filled up, so loading costs no searches. */
+void m_btreeBulkLoad(m_btree *t, long long *expires, RedisModuleString **members, size_t n) {
+    assert(t->root == NULL);
+    if (n == 0) {
+        return;
+    }
+
+    size_t nodes = (n + M_BTREE_LEAF_CAP - 1) / M_BTREE_LEAF_CAP;
+    void **level = RedisModule_Alloc(nodes * sizeof(void *));
+    long long *first_expires = RedisModule_Alloc(nodes * sizeof(long long));
+    RedisModuleString **first_members = RedisModule_Alloc(nodes * sizeof(RedisModuleString *));
+
+    m_btreeLeaf *prev = NULL;
+    for (size_t i = 0; i < nodes; i++) {
+        size_t start = i * M_BTREE_LEAF_CAP;
+        unsigned int len = n - start < M_BTREE_LEAF_CAP ? n - start : M_BTREE_LEAF_CAP;
+        unsigned int cap = M_BTREE_LEAF_CAP;
+        if (nodes == 1) {
+            for (cap = M_BTREE_LEAF_MIN_CAP; cap < len; cap *= 2)
+                ;
+        }
+        m_btreeLeaf *leaf = m_btreeCreateLeaf(t, cap);
+        memcpy(leaf->expires, expires + start, len * sizeof(long long));
+        memcpy(leaf->members, members + start, len * sizeof(RedisModuleString *));
+        leaf->count = len;
+        leaf->prev = prev;
+        if (prev) {
+            prev->next = leaf;
+        } else {
+            t->head = leaf;
+        }
+        prev = leaf;
+        level[i] = leaf;
+        first_expires[i] = expires[start];
+        first_members[i] = members[start];
+    }
+    t->tail = prev;
+
+    int height = 0;
+    while (nodes > 1) {
+        size_t parents = (nodes + M_BTREE_FANOUT - 1) / M_BTREE_FANOUT;
+        for (size_t i = 0; i < parents; i++) {
+            m_btreeInner *inner = m_btreeCreateInner(t);
+            size_t start = i * M_BTREE_FANOUT;
+            inner->count = nodes - start < M_BTREE_FANOUT ? nodes - start : M_BTREE_FANOUT;
+            for (unsigned int j = 0; j < inner->count; j++) {
+                inner->children[j] = level[start + j];
+                if (j > 0) {
+                    inner->expires[j - 1] = first_expires[start + j];
+                    inner->members[j - 1] = first_members[start + j];
+                }
+            }
+            /* The first entry of a subtree is the first entry of its first child. */
+            level[i] = inner;
+            first_expires[i] = first_expires[start];
+            first_members[i] = first_members[start];
+        }
+        nodes = parents;
+        height++;
+    }
+
+    t->root = level[0];
+    t->height = height;
+    t->length = n;
+    RedisModule_Free(level);
+    RedisModule_Free(first_expires);
+    RedisModule_Free(first_members);
+}
+
+static void m_btreeSwapEntries(long long *expires, RedisModuleString **members, size_t a, size_t b) {
+    long long e = expires[a];
+    RedisModuleString *m = members[a];
+    expires[a] = expires[b], members[a] = members[b];
+    expires[b] = e, members[b] = m;
+}
+
+/* Sort two parallel arrays in tree order, used to prepare m_btreeBulkLoad(). */
+void m_btreeSortEntries(long long *expires, RedisModuleString **members, size_t n) {
+    while (n > 16) {
+        size_t mid = n / 2, last = n - 1;
+        /* Median of three as the pivot, moved to the last slot. */
+        if (m_btreeCompare(expires[mid], members[mid], expires[0], members[0]) < 0) m_btreeSwapEntries(expires, members, mid, 0);
+        if (m_btreeCompare(expires[last], members[last], expires[0], members[0]) < 0) m_btreeSwapEntries(expires, members, last, 0);
+        if (m_btreeCompare(expires[mid], members[mid], expires[last], members[last]) < 0) m_btreeSwapEntries(expires, members, mid, last);
+        long long pe = expires[last];
+        RedisModuleString *pm = members[last];
+        size_t store = 0;
+        for (size_t i = 0; i < last; i++) {
+            if (m_btreeCompare(expires[i], members[i], pe, pm) < 0) {
+                m_btreeSwapEntries(expires, members, i, store++);
+            }
+        }
+        m_btreeSwapEntries(expires, members, store, last);
+        /* Recurse into the smaller part, loop on the larger one. */
+        if (store < n - store - 1) {
+            m_btreeSortEntries(expires, members, store);
+            expires += store + 1, members += store + 1, n -= store + 1;
+        } else {
+            m_btreeSortEntries(expires + store + 1, members + store + 1, n - store - 1);
+            n = store;
+        }
+    }
+    for (size_t i = 1; i < n; i++) {
+        for (size_t j = i; j > 0 && m_btreeCompare(expires[j], members[j], expires[j - 1], members[j - 1]) < 0; j--) {
+            m_btreeSwapEntries(expires, members, j, j - 1);
+        }
+    }
+}
+
+size_t m_btreeMemUsage(const m_btree *t) {
+    return sizeof(*t) + t->alloc_size;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "../src/redismodule.h"
+
+/* A B+tree of (expire, member) entries, members are borrowed pointers ordered by
+ * address when expires are equal. Leaves store expires and members in two arrays
+ * and are chained in key order, so walking the head of the tree is a linear scan. */
+#define M_BTREE_LEAF_CAP 64   /* Entries per leaf. */
+#define M_BTREE_LEAF_MIN_CAP 4 /* Capacity of a single root leaf when created. */
+#define M_BTREE_FANOUT 32     /* Children per inner node. */
+
+typedef struct m_btreeLeaf {
+    struct m_btreeLeaf *prev, *next;
+    unsigned int count, cap;
+    long long *expires;
+    RedisModuleString **members;
+} m_btreeLeaf;
+
+typedef struct m_btreeInner {
+    unsigned int count; /* Number of children, there are count - 1 separators. */
+    long long expires[M_BTREE_FANOUT - 1];
+    RedisModuleString *members[M_BTREE_FANOUT - 1];
+    void *children[M_BTREE_FANOUT];
+} m_btreeInner;
+
+typedef struct m_btree {
+    void *root;
+    int height; /* 0 if the root is a leaf. */
+    unsigned long length;
+    size_t alloc_size; /* Bytes allocated for the nodes. */
+    m_btreeLeaf *head, *tail;
+} m_btree;
+
+m_btree *m_btreeCreate(void);
+void m_btreeFree(m_btree *t);
+void m_btreeInsert(m_btree *t, long long expire, RedisModuleString *member);
+int m_btreeDelete(m_btree *t, long long expire, RedisModuleString *member);
+void m_btreeUpdate(m_btree *t, long long cur_expire, RedisModuleString *member, long long new_expire);
+m_btreeLeaf *m_btreeSeek(m_btree *t, long long expire, unsigned int *pos);
+unsigned long m_btreeDeleteHead(m_btree *t, unsigned long count);
+void m_btreeBulkLoad(m_btree *t, long long *expires, RedisModuleString **members, size_t n);
+void m_btreeSortEntries(long long *expires, RedisModuleString **members, size_t n);
+size_t m_btreeMemUsage(const m_btree *t);
@@ -287,8 +287,19 @@ int m_dictAdd(dict *d, void *key, void *val) {
  * If key was added, the hash entry is returned to be manipulated by the caller.
  */
 m_dictEntry *m_dictAddRaw(dict *d, void *key, m_dictEntry **existing) {
+    void *position = m_dictFindPositionForInsert(d, key, existing);
+    if (!position) return NULL;
+    return m_dictInsertAtPosition(d, key, position);
+}
+
+/* Finds the bucket where `key` would be inserted, so that a caller can first
+ * look up a key and then add it without hashing it twice. Returns NULL if the
+ * key already exists, "*existing" is then populated if it is not NULL.
+ *
+ * The position is only valid until the dict is modified, the caller must not
+ * add or delete anything before calling m_dictInsertAtPosition(). */
+void *m_dictFindPositionForInsert(dict *d, const void *key, m_dictEntry **existing) {
     long index;
-    m_dictEntry *entry;
     dictht *ht;
 
     if (dictIsRehashing(d)) _dictRehashStep(d);
@@ -297,6 +308,15 @@ m_dictEntry *m_dictAddRaw(dict *d, void *key, m_dictEntry **existing) {
      * the element already exists. */
     if ((index = _dictKeyIndex(d, key, dictHashKey(d, key), existing)) == -1)
         return NULL;
+    ht = dictIsRehashing(d) ? &d->ht[1] : &d->ht[0];
+    return &ht->table[index];
+}
+
+/* Adds `key` at a position returned by m_dictFindPositionForInsert(). */
+m_dictEntry *m_dictInsertAtPosition(dict *d, void *key, void *position) {
+    m_dictEntry **bucket = position;
+    m_dictEntry *entry;
+    dictht *ht;
 
     /* Allocate the memory and store the new entry.
      * Insert the element in top, with the assumption that in a database
@@ -304,8 +324,8 @@ m_dictEntry *m_dictAddRaw(dict *d, void *key, m_dictEntry **existing) {
      * more frequently. */
     ht = dictIsRehashing(d) ? &d->ht[1] : &d->ht[0];
     entry = zmalloc(sizeof(*entry));
-    entry->next = ht->table[index];
-    ht->table[index] = entry;
+    entry->next = *bucket;
+    *bucket = entry;
     ht->used++;
 
     /* Set the hash entry fields. */
@@ -433,6 +453,16 @@ void m_dictFreeUnlinkedEntry(dict *d, m_dictEntry *he) {
     zfree(he);
 }
 
+/* Put back an entry returned by m_dictUnlink() that is not going to be released.
+ * Only the hash of the key is computed, no key is compared. */
+void m_dictRelinkUnlinkedEntry(dict *d, m_dictEntry *he) {
+    dictht *ht = dictIsRehashing(d) ? &d->ht[1] : &d->ht[0];
+    uint64_t idx = dictHashKey(d, he->key) & ht->sizemask;
+    he->next = ht->table[idx];
+    ht->table[idx] = he;
+    ht->used++;
+}
+
 /* Destroy an entire dictionary */
 int _dictClear(dict *d, dictht *ht, void(callback)(void *)) {
     unsigned long i;
@@ -487,6 +517,63 @@ m_dictEntry *m_dictFind(dict *d, const void *key) {
     return NULL;
 }
 
+#if defined(__GNUC__) || defined(__clang__)
+#define dictPrefetch(addr) __builtin_prefetch(addr)
+#else
+#define dictPrefetch(addr) ((void)(addr))
+#endif
+
+/* Looks up `n` keys at once, entries[i] is set to the entry of keys[i] or NULL.
+ * Keys are processed M_DICT_FIND_BATCH at a time in a few passes: all the keys
+ * are hashed and their buckets prefetched, then the chain heads and their keys
+ * are prefetched, and only then the chains are walked. The cache misses of the
+ * different keys overlap instead of being paid one after another. */
+void m_dictFindBatch(dict *d, void **keys, m_dictEntry **entries, size_t n) {
+    uint64_t hashes[M_DICT_FIND_BATCH];
+    m_dictEntry *heads[M_DICT_FIND_BATCH];
+    size_t base, i, count;
+    uint64_t table;
+    m_dictEntry *he;
+
+    if (d->ht[0].used + d->ht[1].used == 0) {
+        for (i = 0; i < n; i++) entries[i] = NULL;
+        return;
+    }
+    if (dictIsRehashing(d)) _dictRehashStep(d);
+
+    for (base = 0; base < n; base += count) {
+        count = n - base < M_DICT_FIND_BATCH ? n - base : M_DICT_FIND_BATCH;
+
+        for (i = 0; i < count; i++) {
+            hashes[i] = dictHashKey(d, keys[base + i]);
+            dictPrefetch(&d->ht[0].table[hashes[i] & d->ht[0].sizemask]);
+            if (dictIsRehashing(d)) dictPrefetch(&d->ht[1].table[hashes[i] & d->ht[1].sizemask]);
+        }
+        for (i = 0; i < count; i++) {
+            heads[i] = d->ht[0].table[hashes[i] & d->ht[0].sizemask];
+            if (heads[i]) dictPrefetch(heads[i]);
+        }
+        for (i = 0; i < count; i++) {
+            if (heads[i]) dictPrefetch(heads[i]->key);
+        }
+
+        for (i = 0; i < count; i++) {
+            void *key = keys[base + i];
+            entries[base + i] = NULL;
+            for (table = 0; table <= 1; table++) {
+                he = table == 0 ? heads[i] : d->ht[1].table[hashes[i] & d->ht[1].sizemask];
+                while (he && key != he->key && !dictCompareKeys(d, key, he->key)) he = he->next;
+                if (he) {
+                    entries[base + i] = he;
+                    dictPrefetch(he->v.val);
+                    break;
+                }
+                if (!dictIsRehashing(d)) break;
+            }
+        }
+    }
+}
+
 void *m_dictFetchValue(dict *d, const void *key) {
     m_dictEntry *he;
 
@@ -42,6 +42,9 @@
 #define DICT_OK 0
 #define DICT_ERR 1
 
+/* Number of keys m_dictFindBatch() keeps in flight. */
+#define M_DICT_FIND_BATCH 16
+
 /* Unused arguments generate annoying warnings... */
 #define DICT_NOTUSED(V) ((void)V)
 
@@ -159,13 +162,17 @@ dict *m_dictCreate(m_dictType *type, void *privDataPtr);
 int m_dictExpand(dict *d, unsigned long size);
 int m_dictAdd(dict *d, void *key, void *val);
 m_dictEntry *m_dictAddRaw(dict *d, void *key, m_dictEntry **existing);
+void *m_dictFindPositionForInsert(dict *d, const void *key, m_dictEntry **existing);
+m_dictEntry *m_dictInsertAtPosition(dict *d, void *key, void *position);
 m_dictEntry *m_dictAddOrFind(dict *d, void *key);
 int m_dictReplace(dict *d, void *key, void *val);
 int m_dictDelete(dict *d, const void *key);
 m_dictEntry *m_dictUnlink(dict *ht, const void *key);
 void m_dictFreeUnlinkedEntry(dict *d, m_dictEntry *he);
+void m_dictRelinkUnlinkedEntry(dict *d, m_dictEntry *he);
 void m_dictRelease(dict *d);
 m_dictEntry *m_dictFind(dict *d, const void *key);
+void m_dictFindBatch(dict *d, void **keys, m_dictEntry **entries, size_t n);
 void *m_dictFetchValue(dict *d, const void *key);
 int m_dictResize(dict *d);
 m_dictIterator *m_dictGetIterator(dict *d);
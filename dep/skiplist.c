@@ -2,19 +2,128 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "util.h"
 
+/* Size of a node with `level` levels, nodes of the same level share a free list. */
+static inline size_t m_zslNodeSize(int level) {
+    return sizeof(m_zskiplistNode) + level * sizeof(struct zskiplistLevel);
+}
+
+/* Allocate a node with `level` levels. Once pooled, reuse a released node of the
+ * same level, otherwise carve it from the current chunk. */
+static m_zskiplistNode *m_zslPoolAlloc(m_zskiplist *zsl, int level) {
+    size_t size = m_zslNodeSize(level);
+    if (!zsl->pooled) {
+        zsl->alloc_size += size;
+        return RedisModule_Alloc(size);
+    }
+
+    m_zskiplistNode *zn = zsl->free_nodes[level - 1];
+    if (zn) {
+        zsl->free_nodes[level - 1] = zn->backward;
+        return zn;
+    }
+
+    m_zskiplistChunk *chunk = zsl->chunks;
+    if (chunk == NULL || chunk->used + size > chunk->size) {
+        size_t chunk_size = chunk ? chunk->size * 2 : M_ZSL_CHUNK_MIN_SIZE;
+        if (chunk_size > M_ZSL_CHUNK_MAX_SIZE) chunk_size = M_ZSL_CHUNK_MAX_SIZE;
+        if (chunk_size < size) chunk_size = size;
+        chunk = RedisModule_Alloc(sizeof(*chunk) + chunk_size);
+        chunk->next = zsl->chunks;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        zsl->chunks = chunk;
+        zsl->alloc_size += sizeof(*chunk) + chunk_size;
+    }
+    zn = (m_zskiplistNode *)(chunk->data + chunk->used);
+    chunk->used += size;
+    return zn;
+}
+
+/* Give all the chunks back and allocate nodes one by one again, only valid once
+ * no node is in use. */
+static void m_zslPoolReset(m_zskiplist *zsl) {
+    m_zskiplistChunk *chunk = zsl->chunks, *next;
+    while (chunk) {
+        next = chunk->next;
+        RedisModule_Free(chunk);
+        chunk = next;
+    }
+    zsl->chunks = NULL;
+    if (zsl->free_nodes) {
+        RedisModule_Free(zsl->free_nodes);
+        zsl->free_nodes = NULL;
+    }
+    zsl->pooled = 0;
+    zsl->alloc_size = 0;
+}
+
+/* Move every node to the pool once the skiplist is long enough for it to pay off.
+ * Nodes do not record their level, the level of a node is the number of levels
+ * whose next node (walking all of them in order) is that node. Only called before
+ * an insert, when no node pointer of the skiplist is held by the caller. */
+static void m_zslPoolNodes(m_zskiplist *zsl) {
+    m_zskiplistNode *old_next[ZSKIPLIST_MAXLEVEL], *update[ZSKIPLIST_MAXLEVEL];
+    m_zskiplistNode *x = zsl->header->level[0].forward, *backward = NULL;
+    int i;
+
+    for (i = 0; i < zsl->level; i++) {
+        old_next[i] = zsl->header->level[i].forward;
+        update[i] = zsl->header;
+    }
+    zsl->free_nodes = RedisModule_Calloc(zsl->level_tail_size, sizeof(m_zskiplistNode *));
+    zsl->pooled = 1;
+    zsl->alloc_size = 0;
+
+    while (x) {
+        int level = 1;
+        while (level < zsl->level && old_next[level] == x) {
+            level++;
+        }
+        m_zskiplistNode *nx = m_zslPoolAlloc(zsl, level);
+        nx->member = x->member;
+        nx->bucket = x->bucket;
+        nx->score = x->score;
+        nx->backward = backward;
+        for (i = 0; i < level; i++) {
+            old_next[i] = x->level[i].forward;
+            update[i]->level[i].forward = nx;
+            update[i] = nx;
+            if (zsl->level_tail[i] == x) {
+                zsl->level_tail[i] = nx;
+            }
+        }
+        backward = nx;
+        m_zskiplistNode *next = x->level[0].forward;
+        RedisModule_Free(x);
+        x = next;
+    }
+    for (i = 0; i < zsl->level; i++) {
+        update[i]->level[i].forward = NULL;
+    }
+    zsl->tail = backward;
+}
+
 /* Create a skiplist node with the specified number of levels.
- * The SDS string 'ele' is referenced by the node after the call. */
-m_zskiplistNode *m_zslCreateNode(int level, long long score, RedisModuleString *member) {
-    m_zskiplistNode *zn = RedisModule_Alloc(sizeof(*zn) + level * sizeof(struct zskiplistLevel));
+ * The node borrows 'member', it is owned by the hash the index belongs to. */
+static m_zskiplistNode *m_zslCreateNode(m_zskiplist *zsl, int level, long long score, RedisModuleString *member) {
+    m_zskiplistNode *zn = m_zslPoolAlloc(zsl, level);
     zn->score = score;
     zn->member = member;
+    zn->bucket = NULL;
     return zn;
 }
 
+/* Members are identified by their object pointer (the field or key object owned
+ * by the hash), ties between equal scores are broken without touching strings. */
+static inline int m_zslCompareMember(RedisModuleString *a, RedisModuleString *b) {
+    return (uintptr_t)a < (uintptr_t)b ? -1 : ((uintptr_t)a > (uintptr_t)b);
+}
+
 /* Create a new skiplist. */
 m_zskiplist *m_zslCreate(void) {
     int j;
@@ -23,39 +132,85 @@ m_zskiplist *m_zslCreate(void) {
     zsl = RedisModule_Alloc(sizeof(*zsl));
     zsl->level = 1;
     zsl->length = 0;
-    zsl->header = m_zslCreateNode(ZSKIPLIST_MAXLEVEL, 0, NULL);
+    zsl->header = RedisModule_Alloc(m_zslNodeSize(ZSKIPLIST_MAXLEVEL));
+    zsl->header->member = NULL;
+    zsl->header->bucket = NULL;
+    zsl->header->score = 0;
     for (j = 0; j < ZSKIPLIST_MAXLEVEL; j++) {
         zsl->header->level[j].forward = NULL;
-        zsl->header->level[j].span = 0;
     }
     zsl->header->backward = NULL;
     zsl->tail = NULL;
+    zsl->level_tail = NULL;
+    zsl->free_nodes = NULL;
+    zsl->level_tail_size = 0;
+    zsl->pooled = 0;
+    zsl->chunks = NULL;
+    zsl->alloc_size = 0;
     return zsl;
 }
 
-/* Free the specified skiplist node. The referenced SDS string representation
- * of the element is freed too, unless node->ele is set to NULL before calling
- * this function. */
-void m_zslFreeNode(m_zskiplistNode *node) {
-    if (node->member) {
-        RedisModule_FreeString(NULL, node->member);
+/* Make sure `level_tail` and `free_nodes` cover `level` levels, new levels are empty. */
+static void m_zslReserveLevelTail(m_zskiplist *zsl, int level) {
+    if (level <= zsl->level_tail_size) {
+        return;
     }
-    RedisModule_Free(node);
+    zsl->level_tail = RedisModule_Realloc(zsl->level_tail, level * sizeof(m_zskiplistNode *));
+    if (zsl->pooled) {
+        zsl->free_nodes = RedisModule_Realloc(zsl->free_nodes, level * sizeof(m_zskiplistNode *));
+    }
+    for (int i = zsl->level_tail_size; i < level; i++) {
+        zsl->level_tail[i] = zsl->header;
+        if (zsl->pooled) {
+            zsl->free_nodes[i] = NULL;
+        }
+    }
+    zsl->level_tail_size = level;
+}
+
+/* Release a node with `level` levels, to the pool of the skiplist once pooled. Members
+ * are borrowed, so they are never dereferenced here and may already have been released. */
+static void m_zslFreeNode(m_zskiplist *zsl, m_zskiplistNode *node, int level) {
+    if (node->bucket) {
+        RedisModule_Free(node->bucket);
+    }
+    if (!zsl->pooled) {
+        zsl->alloc_size -= m_zslNodeSize(level);
+        RedisModule_Free(node);
+        return;
+    }
+    node->backward = zsl->free_nodes[level - 1];
+    zsl->free_nodes[level - 1] = node;
 }
 
 /* Free a whole skiplist. */
 void m_zslFree(m_zskiplist *zsl) {
-    m_zskiplistNode *node = zsl->header->level[0].forward, *next;
+    m_zskiplistNode *node = zsl->header->level[0].forward;
 
     RedisModule_Free(zsl->header);
     while (node) {
-        next = node->level[0].forward;
-        m_zslFreeNode(node);
+        m_zskiplistNode *next = node->level[0].forward;
+        if (node->bucket) {
+            RedisModule_Free(node->bucket);
+        }
+        if (!zsl->pooled) {
+            RedisModule_Free(node);
+        }
         node = next;
     }
+    m_zslPoolReset(zsl);
+    if (zsl->level_tail) {
+        RedisModule_Free(zsl->level_tail);
+    }
     RedisModule_Free(zsl);
 }
 
+/* Bytes used by the skiplist, including its nodes or the chunks of its node pool. */
+size_t m_zslMemUsage(const m_zskiplist *zsl) {
+    size_t levels = (zsl->pooled ? 2 : 1) * zsl->level_tail_size * sizeof(m_zskiplistNode *);
+    return sizeof(*zsl) + m_zslNodeSize(ZSKIPLIST_MAXLEVEL) + zsl->alloc_size + levels;
+}
+
 /* Returns a random level for the new skiplist node we are going to create.
  * The return value of this function is between 1 and ZSKIPLIST_MAXLEVEL
  * (both inclusive), with a powerlaw-alike distribution where higher
@@ -67,22 +222,28 @@ int m_zslRandomLevel(void) {
     return (level < ZSKIPLIST_MAXLEVEL) ? level : ZSKIPLIST_MAXLEVEL;
 }
 
+static m_zskiplistNode *m_zslAppend(m_zskiplist *zsl, long long score, RedisModuleString *member);
+
 /* Insert a new node in the skiplist. Assumes the element does not already
- * exist (up to the caller to enforce that). The skiplist takes ownership
- * of the passed SDS string 'ele'. */
+ * exist (up to the caller to enforce that). */
 m_zskiplistNode *m_zslInsert(m_zskiplist *zsl, long long score, RedisModuleString *member) {
     m_zskiplistNode *update[ZSKIPLIST_MAXLEVEL], *x;
-    unsigned int rank[ZSKIPLIST_MAXLEVEL];
     int i, level;
 
+    if (!zsl->pooled && zsl->length >= M_ZSL_POOL_MIN_NODES) {
+        m_zslPoolNodes(zsl);
+    }
+
+    /* Fast path: with a fixed relative TTL every new expire goes after the tail. */
+    if (zsl->tail && (zsl->tail->score < score || (zsl->tail->score == score && m_zslCompareMember(zsl->tail->member, member) < 0))) {
+        return m_zslAppend(zsl, score, member);
+    }
+
     x = zsl->header;
     for (i = zsl->level - 1; i >= 0; i--) {
-        /* store rank that is crossed to reach the insert position */
-        rank[i] = i == (zsl->level - 1) ? 0 : rank[i + 1];
         while (x->level[i].forward && 
             (x->level[i].forward->score < score || 
-            (x->level[i].forward->score == score && RedisModule_StringCompare(x->level[i].forward->member, member) < 0))) {
-            rank[i] += x->level[i].span;
+            (x->level[i].forward->score == score && m_zslCompareMember(x->level[i].forward->member, member) < 0))) {
             x = x->level[i].forward;
         }
         update[i] = x;
@@ -93,27 +254,20 @@ m_zskiplistNode *m_zslInsert(m_zskiplist *zsl, long long score, RedisModuleStrin
      * caller of m_zslInsert() should test in the hash table if the element is
      * already inside or not. */
     level = m_zslRandomLevel();
+    m_zslReserveLevelTail(zsl, level);
     if (level > zsl->level) {
         for (i = zsl->level; i < level; i++) {
-            rank[i] = 0;
             update[i] = zsl->header;
-            update[i]->level[i].span = zsl->length;
         }
         zsl->level = level;
     }
-    x = m_zslCreateNode(level, score, member);
+    x = m_zslCreateNode(zsl, level, score, member);
     for (i = 0; i < level; i++) {
         x->level[i].forward = update[i]->level[i].forward;
         update[i]->level[i].forward = x;
-
-        /* update span covered by update[i] as x is inserted here */
-        x->level[i].span = update[i]->level[i].span - (rank[0] - rank[i]);
-        update[i]->level[i].span = (rank[0] - rank[i]) + 1;
-    }
-
-    /* increment span for untouched levels */
-    for (i = level; i < zsl->level; i++) {
-        update[i]->level[i].span++;
+        if (x->level[i].forward == NULL) {
+            zsl->level_tail[i] = x;
+        }
     }
 
     x->backward = (update[0] == zsl->header) ? NULL : update[0];
@@ -125,15 +279,39 @@ m_zskiplistNode *m_zslInsert(m_zskiplist *zsl, long long score, RedisModuleStrin
     return x;
 }
 
-/* Internal function used by m_zslDelete, zslDeleteByScore and zslDeleteByRank */
-void m_zslDeleteNode(m_zskiplist *zsl, m_zskiplistNode *x, m_zskiplistNode **update) {
-    int i;
+/* Append a node after the tail, the caller must make sure it sorts after the tail.
+ * No search is needed since the last node of every level is known. */
+static m_zskiplistNode *m_zslAppend(m_zskiplist *zsl, long long score, RedisModuleString *member) {
+    int i, level = m_zslRandomLevel();
+
+    m_zslReserveLevelTail(zsl, level);
+    if (level > zsl->level) {
+        zsl->level = level;
+    }
+
+    m_zskiplistNode *x = m_zslCreateNode(zsl, level, score, member);
+    for (i = 0; i < level; i++) {
+        zsl->level_tail[i]->level[i].forward = x;
+        x->level[i].forward = NULL;
+        zsl->level_tail[i] = x;
+    }
+    x->backward = zsl->tail;
+    zsl->tail = x;
+    zsl->length++;
+    return x;
+}
+
+/* Internal function used by m_zslDelete, zslDeleteByScore and zslUpdateScore.
+ * Returns the number of levels of `x`, which is needed to release it. */
+int m_zslDeleteNode(m_zskiplist *zsl, m_zskiplistNode *x, m_zskiplistNode **update) {
+    int i, level = 0;
     for (i = 0; i < zsl->level; i++) {
         if (update[i]->level[i].forward == x) {
-            update[i]->level[i].span += x->level[i].span - 1;
+            if (x->level[i].forward == NULL) {
+                zsl->level_tail[i] = update[i];
+            }
             update[i]->level[i].forward = x->level[i].forward;
-        } else {
-            update[i]->level[i].span -= 1;
+            level = i + 1;
         }
     }
     if (x->level[0].forward) {
@@ -144,17 +322,21 @@ void m_zslDeleteNode(m_zskiplist *zsl, m_zskiplistNode *x, m_zskiplistNode **upd
     while (zsl->level > 1 && zsl->header->level[zsl->level - 1].forward == NULL)
         zsl->level--;
     zsl->length--;
+    return level;
+}
+
+/* Release an unlinked node, the pool is given back once the skiplist is empty. */
+static void m_zslReleaseNode(m_zskiplist *zsl, m_zskiplistNode *x, int level) {
+    m_zslFreeNode(zsl, x, level);
+    if (zsl->length == 0) {
+        m_zslPoolReset(zsl);
+    }
 }
 
 /* Delete an element with matching score/element from the skiplist.
  * The function returns 1 if the node was found and deleted, otherwise
- * 0 is returned.
- *
- * If 'node' is NULL the deleted node is freed by m_zslFreeNode(), otherwise
- * it is not freed (but just unlinked) and *node is set to the node pointer,
- * so that it is possible for the caller to reuse the node (including the
- * referenced SDS string at node->ele). */
-int m_zslDelete(m_zskiplist *zsl, long long score, RedisModuleString *member, m_zskiplistNode **node) {
+ * 0 is returned. */
+int m_zslDelete(m_zskiplist *zsl, long long score, RedisModuleString *member) {
     m_zskiplistNode *update[ZSKIPLIST_MAXLEVEL], *x;
     int i;
 
@@ -162,7 +344,7 @@ int m_zslDelete(m_zskiplist *zsl, long long score, RedisModuleString *member, m_
     for (i = zsl->level - 1; i >= 0; i--) {
         while (x->level[i].forward && 
         (x->level[i].forward->score < score || 
-        (x->level[i].forward->score == score && RedisModule_StringCompare(x->level[i].forward->member, member) < 0))) {
+        (x->level[i].forward->score == score && m_zslCompareMember(x->level[i].forward->member, member) < 0))) {
             x = x->level[i].forward;
         }
         update[i] = x;
@@ -170,12 +352,8 @@ int m_zslDelete(m_zskiplist *zsl, long long score, RedisModuleString *member, m_
     /* We may have multiple elements with the same score, what we need
      * is to find the element with both the right score and object. */
     x = x->level[0].forward;
-    if (x && score == x->score && RedisModule_StringCompare(x->member, member) == 0) {
-        m_zslDeleteNode(zsl, x, update);
-        if (!node)
-            m_zslFreeNode(x);
-        else
-            *node = x;
+    if (x && score == x->score && m_zslCompareMember(x->member, member) == 0) {
+        m_zslReleaseNode(zsl, x, m_zslDeleteNode(zsl, x, update));
         return 1;
     }
     return 0; /* not found */
@@ -202,7 +380,7 @@ m_zskiplistNode *m_zslUpdateScore(m_zskiplist *zsl, long long  curscore, RedisMo
     for (i = zsl->level - 1; i >= 0; i--) {
         while (x->level[i].forward && 
             (x->level[i].forward->score < curscore || 
-            (x->level[i].forward->score == curscore && RedisModule_StringCompare(x->level[i].forward->member, member) < 0))) {
+            (x->level[i].forward->score == curscore && m_zslCompareMember(x->level[i].forward->member, member) < 0))) {
             x = x->level[i].forward;
         }
         update[i] = x;
@@ -211,7 +389,7 @@ m_zskiplistNode *m_zslUpdateScore(m_zskiplist *zsl, long long  curscore, RedisMo
     /* Jump to our element: note that this function assumes that the
      * element with the matching score exists. */
     x = x->level[0].forward;
-    assert(x && curscore == x->score && RedisModule_StringCompare(x->member, member) == 0);
+    assert(x && curscore == x->score && m_zslCompareMember(x->member, member) == 0);
 
     /* If the node, after the score update, would be still exactly
      * at the same position, we can just update the score without
@@ -222,13 +400,13 @@ m_zskiplistNode *m_zslUpdateScore(m_zskiplist *zsl, long long  curscore, RedisMo
     }
 
     /* No way to reuse the old node: we need to remove and insert a new
-     * one at a different place. */
-    m_zslDeleteNode(zsl, x, update);
-    m_zskiplistNode *newnode = m_zslInsert(zsl, newscore, x->member);
-    /* We reused the old node x->ele SDS string, free the node now
-     * since m_zslInsert created a new one. */
-    x->member = NULL;
-    m_zslFreeNode(x);
+     * one at a different place. The old node goes to the free list first,
+     * so the insert can reuse it when the level matches. */
+    m_zskiplistBucket *bucket = x->bucket;
+    x->bucket = NULL;
+    m_zslFreeNode(zsl, x, m_zslDeleteNode(zsl, x, update));
+    m_zskiplistNode *newnode = m_zslInsert(zsl, newscore, member);
+    newnode->bucket = bucket;
     return newnode;
 }
 
@@ -331,58 +509,137 @@ unsigned long m_zslDeleteRangeByScore(m_zskiplist *zsl, m_zrangespec *range) {
     /* Delete nodes while in range. */
     while (x && (range->maxex ? x->score < range->max : x->score <= range->max)) {
         m_zskiplistNode *next = x->level[0].forward;
-        m_zslDeleteNode(zsl, x, update);
-        m_zslFreeNode(x); /* Here is where x->ele is actually released. */
+        m_zslReleaseNode(zsl, x, m_zslDeleteNode(zsl, x, update));
         removed++;
         x = next;
     }
     return removed;
 }
 
-/* Delete all the elements with rank between start and end from the skiplist.
- * Start and end are inclusive. Note that start and end need to be 1-based */
-unsigned long m_zslDeleteRangeByRank(m_zskiplist *zsl, unsigned int start, unsigned int end) {
-    m_zskiplistNode *update[ZSKIPLIST_MAXLEVEL], *x;
-    unsigned long traversed = 0, removed = 0;
+/* Delete the first `count` nodes of the skiplist, returns the number of
+ * deleted nodes. The nodes are found walking forward from the header, then
+ * every level is unlinked up to the first node that is kept. */
+unsigned long m_zslDeleteHead(m_zskiplist *zsl, unsigned long count) {
+    m_zskiplistNode *first = zsl->header->level[0].forward, *last = zsl->header, *x, *next;
+    unsigned long removed = 0;
     int i;
 
-    x = zsl->header;
-    for (i = zsl->level - 1; i >= 0; i--) {
-        while (x->level[i].forward && (traversed + x->level[i].span) < start) {
-            traversed += x->level[i].span;
+    while (removed < count && last->level[0].forward) {
+        last = last->level[0].forward;
+        removed++;
+    }
+    if (removed == 0) {
+        return 0;
+    }
+
+    /* The unlinked nodes do not need `backward` anymore, use it to record
+     * the level of each node, so that it can go to the right free list. */
+    for (i = 0; i < zsl->level; i++) {
+        x = zsl->header->level[i].forward;
+        while (x && (x->score < last->score || (x->score == last->score && m_zslCompareMember(x->member, last->member) <= 0))) {
+            x->backward = (m_zskiplistNode *)(uintptr_t)(i + 1);
             x = x->level[i].forward;
         }
-        update[i] = x;
+        zsl->header->level[i].forward = x;
+        if (x == NULL) {
+            zsl->level_tail[i] = zsl->header;
+        }
+    }
+    next = last->level[0].forward;
+    if (next) {
+        next->backward = NULL;
+    } else {
+        zsl->tail = NULL;
     }
+    while (zsl->level > 1 && zsl->header->level[zsl->level - 1].forward == NULL)
+        zsl->level--;
+    zsl->length -= removed;
 
-    traversed++;
-    x = x->level[0].forward;
-    while (x && traversed <= end) {
-        m_zskiplistNode *next = x->level[0].forward;
-        m_zslDeleteNode(zsl, x, update);
-        m_zslFreeNode(x);
-        removed++;
-        traversed++;
-        x = next;
+    x = first;
+    while (x != next) {
+        m_zskiplistNode *n = x->level[0].forward;
+        m_zslFreeNode(zsl, x, (int)(uintptr_t)x->backward);
+        x = n;
+    }
+    if (zsl->length == 0) {
+        m_zslPoolReset(zsl);
     }
     return removed;
 }
 
-m_zskiplistNode* m_zslGetElementByRank(m_zskiplist *zsl, unsigned long rank) {
-    m_zskiplistNode *x;
-    unsigned long traversed = 0;
+/* Find the node with exactly the given score, in a bucketed skiplist there is
+ * at most one node per score. */
+static m_zskiplistNode *m_zslFindByScore(m_zskiplist *zsl, long long score) {
+    m_zskiplistNode *x = zsl->header;
     int i;
 
-    x = zsl->header;
-    for (i = zsl->level-1; i >= 0; i--) {
-        while (x->level[i].forward && (traversed + x->level[i].span) <= rank)
-        {
-            traversed += x->level[i].span;
+    for (i = zsl->level - 1; i >= 0; i--) {
+        while (x->level[i].forward && x->level[i].forward->score < score)
             x = x->level[i].forward;
+    }
+    x = x->level[0].forward;
+    return (x && x->score == score) ? x : NULL;
+}
+
+/* Insert a member into the bucket with the given score, creating the node if
+ * this is the first member of the bucket. Note that `length` counts nodes, not members. */
+m_zskiplistNode *m_zslBucketInsert(m_zskiplist *zsl, long long score, RedisModuleString *member) {
+    m_zskiplistNode *x = m_zslFindByScore(zsl, score);
+    if (x == NULL) {
+        return m_zslInsert(zsl, score, member);
+    }
+
+    m_zskiplistBucket *b = x->bucket;
+    if (b == NULL || b->len == b->cap) {
+        unsigned int cap = b ? b->cap * 2 : 4;
+        b = RedisModule_Realloc(b, sizeof(*b) + cap * sizeof(RedisModuleString *));
+        if (x->bucket == NULL) b->len = 0;
+        b->cap = cap;
+        x->bucket = b;
+    }
+    b->members[b->len++] = member;
+    return x;
+}
+
+/* Delete a member from the bucket with the given score, the node is removed
+ * together with its last member. Returns 1 if the member was found. */
+int m_zslBucketDelete(m_zskiplist *zsl, long long score, RedisModuleString *member) {
+    m_zskiplistNode *x = m_zslFindByScore(zsl, score);
+    if (x == NULL) {
+        return 0;
+    }
+
+    if (m_zslCompareMember(x->member, member) == 0) {
+        if (x->bucket == NULL || x->bucket->len == 0) {
+            return m_zslDelete(zsl, score, x->member);
         }
-        if (traversed == rank) {
-            return x;
+        x->member = m_zslBucketPop(x);
+        return 1;
+    }
+
+    m_zskiplistBucket *b = x->bucket;
+    if (b == NULL) {
+        return 0;
+    }
+    for (unsigned int i = 0; i < b->len; i++) {
+        if (m_zslCompareMember(b->members[i], member) == 0) {
+            b->members[i] = b->members[--b->len];
+            return 1;
         }
     }
-    return NULL;
-}
\ No newline at end of file
+    return 0;
+}
+
+/* Detach the last extra member of the node. Returns NULL if only `node->member` is left. */
+RedisModuleString *m_zslBucketPop(m_zskiplistNode *node) {
+    m_zskiplistBucket *b = node->bucket;
+    if (b == NULL || b->len == 0) {
+        return NULL;
+    }
+    RedisModuleString *member = b->members[--b->len];
+    if (b->len == 0) {
+        RedisModule_Free(b);
+        node->bucket = NULL;
+    }
+    return member;
+}
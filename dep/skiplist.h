@@ -5,23 +5,57 @@
 #define ZSKIPLIST_MAXLEVEL 64 /* Should be enough for 2^64 elements */
 #define ZSKIPLIST_P 0.25      /* Skiplist P = 1/4 */
 
+#define M_ZSL_POOL_MIN_NODES 64         /* Nodes are allocated one by one below this length. */
+#define M_ZSL_CHUNK_MIN_SIZE 128       /* First chunk of a node pool, a few nodes. */
+#define M_ZSL_CHUNK_MAX_SIZE (16 * 1024) /* Chunks double in size up to this. */
+
 typedef struct {
     long long min, max;
     int minex, maxex; /* are min or max exclusive? */
 } m_zrangespec;
 
+/* Extra members sharing the score of a node, used when the expire index is
+ * bucketed by `expire_granularity`. */
+typedef struct m_zskiplistBucket {
+    unsigned int len, cap;
+    RedisModuleString *members[];
+} m_zskiplistBucket;
+
 typedef struct m_zskiplistNode {
-    RedisModuleString *member; 
+    RedisModuleString *member; /* Borrowed from the hash that owns the index. */
+    m_zskiplistBucket *bucket;
     long long score;
     struct m_zskiplistNode *backward;
     struct zskiplistLevel {
         struct m_zskiplistNode *forward;
-        unsigned long span;
     } level[];
 } m_zskiplistNode;
 
+/* Once a skiplist reaches M_ZSL_POOL_MIN_NODES nodes, its nodes are moved to chunks
+ * owned by the skiplist, released nodes are then kept in a free list per level and
+ * reused by the next node of the same level. Small skiplists (most keys have a few
+ * fields with expire) allocate each node on its own and pay for no chunk.
+ *
+ * The tradeoff: chunks are only given back when the skiplist becomes empty, nodes
+ * can not be moved out of a chunk since the callers keep node pointers across
+ * deletions. A big skiplist that shrinks keeps its peak node memory, which is
+ * reused by later inserts of any level only through the free list of that level. */
+typedef struct m_zskiplistChunk {
+    struct m_zskiplistChunk *next;
+    size_t size, used;
+    char data[];
+} m_zskiplistChunk;
+
 typedef struct m_zskiplist {
     struct m_zskiplistNode *header, *tail;
+    /* Last node of each level (the header if the level is empty), so that appending
+     * after the tail does not need to search from the header. */
+    struct m_zskiplistNode **level_tail;
+    struct m_zskiplistNode **free_nodes; /* Released nodes by level once pooled, as many as `level_tail`. */
+    int level_tail_size;
+    int pooled; /* Nodes are allocated from `chunks`. */
+    m_zskiplistChunk *chunks;
+    size_t alloc_size; /* Bytes allocated for the nodes, or for the chunks once pooled. */
     unsigned long length;
     int level;
 } m_zskiplist;
@@ -29,12 +63,15 @@ typedef struct m_zskiplist {
 m_zskiplist *m_zslCreate(void);
 void m_zslFree(m_zskiplist *zsl);
 m_zskiplistNode *m_zslInsert(m_zskiplist *zsl, long long score, RedisModuleString *member);
-int m_zslDelete(m_zskiplist *zsl, long long score, RedisModuleString *member, m_zskiplistNode **node);
+int m_zslDelete(m_zskiplist *zsl, long long score, RedisModuleString *member);
 m_zskiplistNode *m_zslFirstInRange(m_zskiplist *zsl, m_zrangespec *range);
 m_zskiplistNode *m_zslLastInRange(m_zskiplist *zsl, m_zrangespec *range);
 int m_zslValueGteMin(long long value, m_zrangespec *spec);
 int m_zslValueLteMax(long long value, m_zrangespec *spec);
-void m_zslDeleteNode(m_zskiplist *zsl, m_zskiplistNode *x, m_zskiplistNode **update);
+int m_zslDeleteNode(m_zskiplist *zsl, m_zskiplistNode *x, m_zskiplistNode **update);
 m_zskiplistNode *m_zslUpdateScore(m_zskiplist *zsl, long long  curscore, RedisModuleString *member, long long newscore);
-m_zskiplistNode* m_zslGetElementByRank(m_zskiplist *zsl, unsigned long rank);
-unsigned long m_zslDeleteRangeByRank(m_zskiplist *zsl, unsigned int start, unsigned int end);
\ No newline at end of file
+unsigned long m_zslDeleteHead(m_zskiplist *zsl, unsigned long count);
+size_t m_zslMemUsage(const m_zskiplist *zsl);
+m_zskiplistNode *m_zslBucketInsert(m_zskiplist *zsl, long long score, RedisModuleString *member);
+int m_zslBucketDelete(m_zskiplist *zsl, long long score, RedisModuleString *member);
+RedisModuleString *m_zslBucketPop(m_zskiplistNode *node);
@@ -64,7 +64,7 @@ tairhash_zskiplistNode *tairhash_zslGetNode(tairhash_zskiplist *zsl, RedisModule
 
     x = zsl->header;
     for (int i = zsl->level - 1; i >= 0; i--) {
-        while (x->level[i].forward && (x->level[i].forward->expire_min < expire_min || (x->level[i].forward->expire_min == expire_min && RedisModule_StringCompare(x->level[i].forward->key_min, key_min) <= 0))) {
+        while (x->level[i].forward && (x->level[i].forward->expire_min < expire_min || (x->level[i].forward->expire_min == expire_min && slab_keyCompare(x->level[i].forward->key_min, key_min) <= 0))) {
             x = x->level[i].forward;
         }
     }
@@ -79,7 +79,7 @@ tairhash_zskiplistNode *tairhash_zslInsertNode(tairhash_zskiplist *zsl, Slab *sl
     x = zsl->header;
     for (i = zsl->level - 1; i >= 0; i--) {
         rank[i] = i == (zsl->level - 1) ? 0 : rank[i + 1];
-        while (x->level[i].forward && (x->level[i].forward->expire_min < expire_min || (x->level[i].forward->expire_min == expire_min && RedisModule_StringCompare(x->level[i].forward->key_min, key_min) < 0))) {
+        while (x->level[i].forward && (x->level[i].forward->expire_min < expire_min || (x->level[i].forward->expire_min == expire_min && slab_keyCompare(x->level[i].forward->key_min, key_min) < 0))) {
             rank[i] += x->level[i].span;
             x = x->level[i].forward;
         }
@@ -143,14 +143,14 @@ int tairhash_zslDelete(tairhash_zskiplist *zsl, RedisModuleString *key, long lon
 
     x = zsl->header;
     for (int i = zsl->level - 1; i >= 0; i--) {
-        while (x->level[i].forward && (x->level[i].forward->expire_min < expire || (x->level[i].forward->expire_min == expire && RedisModule_StringCompare(x->level[i].forward->key_min, key) < 0))) {
+        while (x->level[i].forward && (x->level[i].forward->expire_min < expire || (x->level[i].forward->expire_min == expire && slab_keyCompare(x->level[i].forward->key_min, key) < 0))) {
             x = x->level[i].forward;
         }
         update[i] = x;
     }
     x = x->level[0].forward;
 
-    if (x && expire == x->expire_min && RedisModule_StringCompare(x->key_min, key) == 0) {
+    if (x && expire == x->expire_min && slab_keyCompare(x->key_min, key) == 0) {
         tairhash_zslDeleteNode(zsl, x, update);
         tairhash_zslFreeNode(x);
         return 1;
@@ -164,7 +164,7 @@ tairhash_zskiplistNode *tairhash_zslUpdateNode(tairhash_zskiplist *zsl, RedisMod
      * we'll have to update or remove it. */
     x = zsl->header;
     for (int i = zsl->level - 1; i >= 0; i--) {
-        while (x->level[i].forward && (x->level[i].forward->expire_min < cur_expire_min || (x->level[i].forward->expire_min == cur_expire_min && RedisModule_StringCompare(x->level[i].forward->key_min, cur_key_min) < 0))) {
+        while (x->level[i].forward && (x->level[i].forward->expire_min < cur_expire_min || (x->level[i].forward->expire_min == cur_expire_min && slab_keyCompare(x->level[i].forward->key_min, cur_key_min) < 0))) {
             x = x->level[i].forward;
         }
         update[i] = x;
@@ -172,7 +172,7 @@ tairhash_zskiplistNode *tairhash_zslUpdateNode(tairhash_zskiplist *zsl, RedisMod
     x = x->level[0].forward;
     /* Jump to our element: note that this function assumes that the
      * element with the matching expire_min. */
-    assert(x && cur_expire_min == x->expire_min && RedisModule_StringCompare(x->key_min, cur_key_min) == 0);
+    assert(x && cur_expire_min == x->expire_min && slab_keyCompare(x->key_min, cur_key_min) == 0);
 
     /* If the node, after the expire_min update, would be still exactly
      * at the same position, we can just update the expire_min without
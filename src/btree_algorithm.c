@@ -0,0 +1,326 @@
+/*
+ * Copyright 2021 Alibaba Tair Team
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "tairhash.h"
+
+#if defined(BTREE_MODE)
+extern ExpireAlgorithm g_expire_algorithm;
+extern m_zskiplist **g_expire_index;
+extern RedisModuleType *TairHashType;
+
+/* Like SORT_MODE, keys are sorted in the global index by a lower bound of their earliest
+ * field expire, but the fields of each key are kept in a B+tree (see btree.h). Expired
+ * fields are always a prefix of the tree, they are removed by dropping whole leaves. */
+
+static inline long long minExpire(tairHashObj *o) {
+    return o->expire_index->head->expires[0];
+}
+
+void insert(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, long long expire) {
+    REDISMODULE_NOT_USED(ctx);
+    REDISMODULE_NOT_USED(key);
+    if (expire) {
+        m_btreeInsert(o->expire_index, expire, field);
+        expireFieldAdded(o, expire);
+        globalExpireIndexUpdate(dbid, o, minExpire(o));
+    }
+}
+
+void update(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, long long cur_expire, long long new_expire) {
+    REDISMODULE_NOT_USED(ctx);
+    REDISMODULE_NOT_USED(key);
+    if (cur_expire != new_expire) {
+        Module_Assert(o->expire_index->length != 0);
+        m_btreeUpdate(o->expire_index, cur_expire, field, new_expire);
+        expireFieldUpdated(o, cur_expire, new_expire);
+        globalExpireIndexUpdate(dbid, o, minExpire(o));
+    }
+}
+
+void delete(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, long long cur_expire) {
+    REDISMODULE_NOT_USED(ctx);
+    REDISMODULE_NOT_USED(dbid);
+    REDISMODULE_NOT_USED(key);
+    if (cur_expire != 0) {
+        /* The global index entry of the key is left as it is, it is still a lower bound. */
+        m_btreeDelete(o->expire_index, cur_expire, field);
+        expireFieldRemoved(o, cur_expire);
+    }
+}
+
+long long maxExpire(tairHashObj *o, long long cur_expire) {
+    REDISMODULE_NOT_USED(cur_expire);
+    m_btreeLeaf *tail = o->expire_index->tail;
+    return tail && tail->count ? tail->expires[tail->count - 1] : 0;
+}
+
+size_t rangeByExpire(tairHashObj *o, long long min, long long max, long long *expires, RedisModuleString **fields, size_t limit) {
+    unsigned int i;
+    m_btreeLeaf *leaf = m_btreeSeek(o->expire_index, min, &i);
+    size_t n = 0;
+    while (leaf && n < limit) {
+        if (i == leaf->count) {
+            leaf = leaf->next;
+            i = 0;
+            continue;
+        }
+        if (leaf->expires[i] > max) {
+            break;
+        }
+        expires[n] = leaf->expires[i];
+        fields[n++] = leaf->members[i];
+        i++;
+    }
+    return n;
+}
+
+unsigned long countExpired(tairHashObj *o, long long now) {
+    m_btreeLeaf *leaf = o->expire_index->head;
+    unsigned long n = 0;
+    while (leaf && leaf->count && leaf->expires[leaf->count - 1] < now) {
+        n += leaf->count;
+        leaf = leaf->next;
+    }
+    for (unsigned int i = 0; leaf && i < leaf->count && leaf->expires[i] < now; i++) {
+        n++;
+    }
+    return n;
+}
+
+void bulkInsert(int dbid, tairHashObj *o, long long *expires, RedisModuleString **fields, size_t n) {
+    Module_Assert(o->expire_index->length == 0);
+    if (n == 0) {
+        return;
+    }
+    m_btreeSortEntries(expires, fields, n);
+    m_btreeBulkLoad(o->expire_index, expires, fields, n);
+    for (size_t i = 0; i < n; i++) {
+        expireFieldAdded(o, expires[i]);
+    }
+    globalExpireIndexUpdate(dbid, o, minExpire(o));
+}
+
+/* Expire the fields of a key from the head of its B+tree, at most `*budget` of them.
+ * Returns 1 if the key still has fields waiting to expire. `real_key` is closed. */
+static int expireKeyFields(RedisModuleCtx *ctx, int dbid, RedisModuleKey *real_key, RedisModuleString *key, tairHashObj *o, int *budget, uint64_t *stat) {
+    m_btreeLeaf *leaf = o->expire_index->head;
+    unsigned int i = 0;
+    unsigned long expired = 0;
+
+    while (leaf && *budget) {
+        /* The field is released by the dict delete, the tree never dereferences it. */
+        if (!fieldExpireIfNeeded(ctx, dbid, key, o, leaf->members[i], 1)) {
+            break;
+        }
+        (*stat)++;
+        (*budget)--;
+        expired++;
+        if (++i == leaf->count) {
+            leaf = leaf->next;
+            i = 0;
+        }
+    }
+
+    if (expired) {
+        m_btreeDeleteHead(o->expire_index, expired);
+        /* `o` may be released here, it has no fields with expire left. */
+        if (leaf == NULL && delEmptyTairHashIfNeeded(ctx, real_key, key, o)) {
+            return 0;
+        }
+    }
+    RedisModule_CloseKey(real_key);
+    return leaf != NULL;
+}
+
+void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
+    int start_index;
+    long long when, now;
+    unsigned long zsl_len;
+    int expire_keys_per_loop = keys_per_loop;
+
+    m_zskiplistNode *ln = NULL;
+
+    RedisModuleString *key;
+    RedisModuleKey *real_key;
+
+    tairHashObj *tair_hash_obj = NULL;
+    list *keys = m_listCreate();
+
+    /* 1. The current db does not have a key that needs to expire. */
+    zsl_len = g_expire_index[dbid]->length;
+    if (zsl_len == 0) {
+        m_listRelease(keys);
+        return;
+    }
+
+    /* 2. Enumerates expired keys. */
+    ln = g_expire_index[dbid]->header->level[0].forward;
+    start_index = 0;
+    while (ln && expire_keys_per_loop--) {
+        key = ln->member;
+        when = ln->score;
+        now = RedisModule_Milliseconds();
+        if (when > now) {
+            break;
+        }
+        start_index++;
+        m_listAddNodeTail(keys, key);
+        ln = ln->level[0].forward;
+    }
+
+    if (start_index) {
+        /* It is assumed that these keys will all be deleted. */
+        m_zslDeleteHead(g_expire_index[dbid], start_index);
+    }
+
+    if (listLength(keys) == 0) {
+        m_listRelease(keys);
+        return;
+    }
+
+    /* 3. Delete expired field. */
+    expire_keys_per_loop = keys_per_loop;
+    m_listNode *node;
+    while ((node = listFirst(keys)) != NULL) {
+        key = listNodeValue(node);
+        real_key = RedisModule_OpenKey(ctx, key, REDISMODULE_READ | REDISMODULE_WRITE | REDISMODULE_OPEN_KEY_NOTOUCH);
+        int type = RedisModule_KeyType(real_key);
+        if (type != REDISMODULE_KEYTYPE_EMPTY) {
+            Module_Assert(RedisModule_ModuleTypeGetType(real_key) == TairHashType);
+        } else {
+            m_listDelNode(keys, node);
+            continue;
+        }
+
+        tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
+        /* The entry has been popped, the key is re-indexed below if it still has fields to expire. */
+        tair_hash_obj->global_expire_score = 0;
+        if (keyExpireIfNeeded(ctx, dbid, real_key, key, tair_hash_obj, 1)) {
+            m_listDelNode(keys, node);
+            continue;
+        }
+
+        if (tair_hash_obj->expire_index->length == 0) {
+            /* A stale entry, all the fields with expire have been deleted or persisted. */
+            RedisModule_CloseKey(real_key);
+            m_listDelNode(keys, node);
+            continue;
+        }
+
+        if (expireKeyFields(ctx, dbid, real_key, key, tair_hash_obj, &expire_keys_per_loop, &g_expire_algorithm.stat_active_expired_field[dbid])) {
+            globalExpireIndexUpdate(dbid, tair_hash_obj, minExpire(tair_hash_obj));
+        }
+
+        m_listDelNode(keys, node);
+    }
+
+    m_listRelease(keys);
+}
+
+void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *up_key) {
+    REDISMODULE_NOT_USED(up_key);
+    int keys_per_loop = g_expire_algorithm.effective_keys_per_passive_loop;
+    long long when, now;
+    int start_index = 0;
+    m_zskiplistNode *ln = NULL;
+
+    RedisModuleString *key;
+    RedisModuleKey *real_key;
+    unsigned long zsl_len;
+    tairHashObj *tair_hash_obj = NULL;
+
+    list *keys = m_listCreate();
+    /* 1. The current db does not have a key that needs to expire. */
+    zsl_len = g_expire_index[dbid]->length;
+    if (zsl_len == 0) {
+        m_listRelease(keys);
+        return;
+    }
+
+    /* Reuse the current time for fields. */
+    now = RedisModule_Milliseconds();
+
+    /* 2. Enumerates expired keys */
+    ln = g_expire_index[dbid]->header->level[0].forward;
+    start_index = 0;
+    while (ln && keys_per_loop--) {
+        key = ln->member;
+        when = ln->score;
+        if (when > now) {
+            break;
+        }
+        start_index++;
+        m_listAddNodeTail(keys, key);
+        ln = ln->level[0].forward;
+    }
+
+    if (start_index) {
+        m_zslDeleteHead(g_expire_index[dbid], start_index);
+    }
+
+    if (listLength(keys) == 0) {
+        m_listRelease(keys);
+        return;
+    }
+
+    /* 3. Delete expired field. */
+    keys_per_loop = g_expire_algorithm.effective_keys_per_passive_loop;
+    m_listNode *node;
+    while ((node = listFirst(keys)) != NULL) {
+        key = listNodeValue(node);
+        real_key = RedisModule_OpenKey(ctx, key, REDISMODULE_READ | REDISMODULE_WRITE);
+        int type = RedisModule_KeyType(real_key);
+
+        Module_Assert(type != REDISMODULE_KEYTYPE_EMPTY && RedisModule_ModuleTypeGetType(real_key) == TairHashType);
+        tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
+        /* The entry has been popped, the key is re-indexed below if it still has fields to expire. */
+        tair_hash_obj->global_expire_score = 0;
+        if (keyExpireIfNeeded(ctx, dbid, real_key, key, tair_hash_obj, 0)) {
+            m_listDelNode(keys, node);
+            continue;
+        }
+
+        if (tair_hash_obj->expire_index->length == 0) {
+            /* A stale entry, all the fields with expire have been deleted or persisted. */
+            RedisModule_CloseKey(real_key);
+            m_listDelNode(keys, node);
+            continue;
+        }
+
+        if (expireKeyFields(ctx, dbid, real_key, key, tair_hash_obj, &keys_per_loop, &g_expire_algorithm.stat_passive_expired_field[dbid])) {
+            globalExpireIndexUpdate(dbid, tair_hash_obj, minExpire(tair_hash_obj));
+        }
+
+        m_listDelNode(keys, node);
+    }
+
+    m_listRelease(keys);
+}
+
+void deleteAndPropagate(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, long long expire, int is_timer) {
+    RedisModuleString *key_dup = RedisModule_CreateStringFromString(NULL, key);
+    RedisModuleString *field_dup = RedisModule_CreateStringFromString(NULL, field);
+    if (!is_timer) {
+        m_btreeDelete(o->expire_index, expire, field);
+    }
+    expireFieldRemoved(o, expire);
+    tairHashDeleteField(ctx, o, field);
+    RedisModule_Replicate(ctx, "EXHDEL", "ss", key_dup, field_dup);
+    notifyFieldSpaceEvent("expired", key_dup, field_dup, dbid);
+    RedisModule_FreeString(NULL, key_dup);
+    RedisModule_FreeString(NULL, field_dup);
+}
+
+#endif
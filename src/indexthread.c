@@ -0,0 +1,152 @@
+/*
+ * Copyright 2021 Alibaba Tair Team
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "indexthread.h"
+
+#include <pthread.h>
+
+/* With `index_thread` the field expire indexes are owned by a background thread, write
+ * commands only queue the change and the expire cycles ask the thread for due fields
+ * with indexThreadRun(), which waits until every job queued before it has been applied. */
+static pthread_t index_thread;
+static int index_thread_started = 0;
+
+/* Vyukov's intrusive MPSC queue: producers swap `queue_head`, the consumer pops from
+ * `queue_tail`. `queue_stub` keeps the queue non-empty so push never needs a lock. */
+static indexJob queue_stub;
+static indexJob *queue_head = &queue_stub;
+static indexJob *queue_tail = &queue_stub;
+
+/* The thread sleeps when there is nothing pending, producers only take the mutex to
+ * wake it up. */
+static pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t index_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t index_done_cond = PTHREAD_COND_INITIALIZER;
+static int index_thread_sleeping = 0;
+
+static int64_t index_pending_jobs = 0;
+static uint64_t index_processed_jobs = 0;
+
+static void queuePush(indexJob *job) {
+    __atomic_store_n(&job->next, NULL, __ATOMIC_RELAXED);
+    indexJob *prev = __atomic_exchange_n(&queue_head, job, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, job, __ATOMIC_RELEASE);
+}
+
+/* Returns NULL if the queue is empty or a producer is still linking its job. */
+static indexJob *queuePop(void) {
+    indexJob *tail = queue_tail;
+    indexJob *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &queue_stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        queue_tail = next;
+        tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        queue_tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    queuePush(&queue_stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        queue_tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static void *indexThreadMain(void *arg) {
+    REDISMODULE_NOT_USED(arg);
+
+    while (1) {
+        indexJob *job = queuePop();
+        if (job == NULL) {
+            pthread_mutex_lock(&index_mutex);
+            __atomic_store_n(&index_thread_sleeping, 1, __ATOMIC_SEQ_CST);
+            while (__atomic_load_n(&index_pending_jobs, __ATOMIC_SEQ_CST) <= 0 && index_thread_sleeping) {
+                pthread_cond_wait(&index_cond, &index_mutex);
+            }
+            __atomic_store_n(&index_thread_sleeping, 0, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&index_mutex);
+            continue;
+        }
+
+        __atomic_sub_fetch(&index_pending_jobs, 1, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&index_processed_jobs, 1, __ATOMIC_RELAXED);
+        job->run(job);
+    }
+    return NULL;
+}
+
+int indexThreadInit(void) {
+    if (index_thread_started) {
+        return REDISMODULE_OK;
+    }
+
+    if (pthread_create(&index_thread, NULL, indexThreadMain, NULL) != 0) {
+        return REDISMODULE_ERR;
+    }
+    pthread_detach(index_thread);
+    index_thread_started = 1;
+    return REDISMODULE_OK;
+}
+
+/* Queue `job`, it must not be touched by the caller anymore. */
+void indexThreadSubmit(indexJob *job) {
+    queuePush(job);
+    __atomic_add_fetch(&index_pending_jobs, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&index_thread_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&index_mutex);
+        index_thread_sleeping = 0;
+        pthread_cond_signal(&index_cond);
+        pthread_mutex_unlock(&index_mutex);
+    }
+}
+
+/* Queue `job` and wait for it, the `run` callback must call indexThreadJobDone(). Since
+ * jobs are applied in order, every change queued by the caller before is visible to it. */
+void indexThreadRun(indexJob *job) {
+    job->done = 0;
+    indexThreadSubmit(job);
+    pthread_mutex_lock(&index_mutex);
+    while (!job->done) {
+        pthread_cond_wait(&index_done_cond, &index_mutex);
+    }
+    pthread_mutex_unlock(&index_mutex);
+}
+
+/* Called in the index thread by jobs submitted with indexThreadRun(). */
+void indexThreadJobDone(indexJob *job) {
+    pthread_mutex_lock(&index_mutex);
+    job->done = 1;
+    pthread_cond_broadcast(&index_done_cond);
+    pthread_mutex_unlock(&index_mutex);
+}
+
+uint64_t indexThreadGetPendingJobs(void) {
+    int64_t pending = __atomic_load_n(&index_pending_jobs, __ATOMIC_RELAXED);
+    return pending > 0 ? (uint64_t)pending : 0;
+}
+
+uint64_t indexThreadGetProcessedJobs(void) {
+    return __atomic_load_n(&index_processed_jobs, __ATOMIC_RELAXED);
+}
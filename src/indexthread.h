@@ -0,0 +1,35 @@
+/*
+ * Copyright 2021 Alibaba Tair Team
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "tairhash.h"
+
+/* A job handed to the index thread, `run` is called in the thread and owns the job,
+ * unless it was submitted with indexThreadRun() where the caller keeps it. Jobs are
+ * linked into a lock-free multi-producer single-consumer queue, any thread (the main
+ * thread or the redis lazyfree thread freeing a whole key) can submit. */
+typedef struct indexJob {
+    struct indexJob *next;
+    void (*run)(struct indexJob *job);
+    int done; /* Set by the index thread once a job submitted with indexThreadRun() is done. */
+} indexJob;
+
+int indexThreadInit(void);
+void indexThreadSubmit(indexJob *job);
+void indexThreadRun(indexJob *job);
+void indexThreadJobDone(indexJob *job);
+uint64_t indexThreadGetPendingJobs(void);
+uint64_t indexThreadGetProcessedJobs(void);
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2021 Alibaba Tair Team
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "lazyfree.h"
+
+#include <pthread.h>
+
+extern ExpireAlgorithm g_expire_algorithm;
+
+/* Values of deleted or expired fields that are bigger than `lazyfree_threshold` are
+ * handed to a background thread, just like what UNLINK does for whole keys. */
+static pthread_t lazyfree_thread;
+static pthread_mutex_t lazyfree_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t lazyfree_cond = PTHREAD_COND_INITIALIZER;
+static list *lazyfree_jobs = NULL;
+static int lazyfree_started = 0;
+
+static uint64_t lazyfree_pending_objects = 0;
+static uint64_t lazyfree_freed_objects = 0;
+static uint64_t lazyfree_sync_freed_objects = 0;
+
+static void *lazyfreeThreadMain(void *arg) {
+    REDISMODULE_NOT_USED(arg);
+
+    while (1) {
+        pthread_mutex_lock(&lazyfree_mutex);
+        while (listLength(lazyfree_jobs) == 0) {
+            pthread_cond_wait(&lazyfree_cond, &lazyfree_mutex);
+        }
+        /* Take the whole batch so that the main thread is never blocked while we free. */
+        list *jobs = lazyfree_jobs;
+        lazyfree_jobs = m_listCreate();
+        pthread_mutex_unlock(&lazyfree_mutex);
+
+        m_listNode *node;
+        while ((node = listFirst(jobs)) != NULL) {
+            tairHashValRelease(listNodeValue(node));
+            m_listDelNode(jobs, node);
+            __atomic_sub_fetch(&lazyfree_pending_objects, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&lazyfree_freed_objects, 1, __ATOMIC_RELAXED);
+        }
+        m_listRelease(jobs);
+    }
+    return NULL;
+}
+
+int lazyfreeInit(void) {
+    if (lazyfree_started) {
+        return REDISMODULE_OK;
+    }
+
+    lazyfree_jobs = m_listCreate();
+    if (pthread_create(&lazyfree_thread, NULL, lazyfreeThreadMain, NULL) != 0) {
+        m_listRelease(lazyfree_jobs);
+        lazyfree_jobs = NULL;
+        return REDISMODULE_ERR;
+    }
+    pthread_detach(lazyfree_thread);
+    lazyfree_started = 1;
+    return REDISMODULE_OK;
+}
+
+/* Release `val` in the lazyfree thread if its value is big enough, return 1 if the value
+ * has been handed over (the caller must not touch it anymore), otherwise 0 is returned and
+ * the caller is responsible for freeing it.
+ *
+ * Inside MULTI or scripts the value may still be referenced by the argv of a previous
+ * command of the same transaction, decreasing the refcount concurrently would be a race,
+ * so we always free synchronously there. */
+int lazyfreeTairHashValIfNeeded(RedisModuleCtx *ctx, TairHashVal *val) {
+    if (!lazyfree_started || val == NULL || val->value == NULL || g_expire_algorithm.lazyfree_threshold == 0) {
+        return 0;
+    }
+
+    size_t len;
+    RedisModule_StringPtrLen(val->value, &len);
+    if (len < g_expire_algorithm.lazyfree_threshold) {
+        return 0;
+    }
+
+    if (ctx && (RedisModule_GetContextFlags(ctx) & (REDISMODULE_CTX_FLAGS_MULTI | REDISMODULE_CTX_FLAGS_LUA))) {
+        return 0;
+    }
+
+    /* Back-pressure: if the lazyfree thread can not keep up, free it on the caller. */
+    if (__atomic_load_n(&lazyfree_pending_objects, __ATOMIC_RELAXED) >= g_expire_algorithm.lazyfree_max_pending) {
+        lazyfree_sync_freed_objects++;
+        return 0;
+    }
+
+    __atomic_add_fetch(&lazyfree_pending_objects, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&lazyfree_mutex);
+    m_listAddNodeTail(lazyfree_jobs, val);
+    pthread_cond_signal(&lazyfree_cond);
+    pthread_mutex_unlock(&lazyfree_mutex);
+    return 1;
+}
+
+uint64_t lazyfreeGetPendingObjects(void) {
+    return __atomic_load_n(&lazyfree_pending_objects, __ATOMIC_RELAXED);
+}
+
+uint64_t lazyfreeGetFreedObjects(void) {
+    return __atomic_load_n(&lazyfree_freed_objects, __ATOMIC_RELAXED);
+}
+
+uint64_t lazyfreeGetSyncFreedObjects(void) {
+    return lazyfree_sync_freed_objects;
+}
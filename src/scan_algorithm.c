@@ -15,7 +15,7 @@
  */
 #include "tairhash.h"
 
-#if (!defined SORT_MODE) && (!defined SLAB_MODE)
+#if (!defined SORT_MODE) && (!defined SLAB_MODE) && (!defined BTREE_MODE)
 
 extern ExpireAlgorithm g_expire_algorithm;
 extern RedisModuleType *TairHashType;
@@ -25,7 +25,8 @@ void insert(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *
     REDISMODULE_NOT_USED(dbid);
     REDISMODULE_NOT_USED(key);
     if (expire) {
-        m_zslInsert(obj->expire_index, expire, takeAndRef(field));
+        m_zslInsert(obj->expire_index, expire, field);
+        expireFieldAdded(obj, expire);
     }
 }
 
@@ -35,6 +36,7 @@ void update(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *
     REDISMODULE_NOT_USED(key);
     if (cur_expire != new_expire) {
         m_zslUpdateScore(obj->expire_index, cur_expire, field, new_expire);
+        expireFieldUpdated(obj, cur_expire, new_expire);
     }
 }
 
@@ -43,10 +45,38 @@ void delete(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *
     REDISMODULE_NOT_USED(dbid);
     REDISMODULE_NOT_USED(key);
     if (cur_expire != 0) {
-        m_zslDelete(obj->expire_index, cur_expire, field, NULL);
+        m_zslDelete(obj->expire_index, cur_expire, field);
+        expireFieldRemoved(obj, cur_expire);
     }
 }
 
+long long maxExpire(tairHashObj *obj, long long cur_expire) {
+    REDISMODULE_NOT_USED(cur_expire);
+    return obj->expire_index->tail ? obj->expire_index->tail->score : 0;
+}
+
+size_t rangeByExpire(tairHashObj *obj, long long min, long long max, long long *expires, RedisModuleString **fields, size_t limit) {
+    m_zrangespec range = {min, max, 0, 0};
+    m_zskiplistNode *ln = m_zslFirstInRange(obj->expire_index, &range);
+    size_t n = 0;
+    while (ln && ln->score <= max && n < limit) {
+        expires[n] = ln->score;
+        fields[n++] = ln->member;
+        ln = ln->level[0].forward;
+    }
+    return n;
+}
+
+unsigned long countExpired(tairHashObj *obj, long long now) {
+    m_zskiplistNode *ln = obj->expire_index->header->level[0].forward;
+    unsigned long n = 0;
+    while (ln && ln->score < now) {
+        n++;
+        ln = ln->level[0].forward;
+    }
+    return n;
+}
+
 void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
     tairHashObj *tair_hash_obj = NULL;
     int start_index;
@@ -65,8 +95,11 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
     list *keys = m_listCreate();
     /* Each db has its own cursor, but this value may be wrong when swapdb appears (because we do not have a callback notification),
      * But this will not cause serious problems. */
-    static long long scan_cursor[DB_NUM] = {0};
-    RedisModuleCallReply *reply = RedisModule_Call(ctx, "SCAN", "lcl", scan_cursor[dbid], "COUNT", g_expire_algorithm.keys_per_active_loop);
+    static long long *scan_cursor = NULL;
+    if (scan_cursor == NULL) {
+        scan_cursor = RedisModule_Calloc(g_expire_algorithm.db_num, sizeof(long long));
+    }
+    RedisModuleCallReply *reply = RedisModule_Call(ctx, "SCAN", "lcl", scan_cursor[dbid], "COUNT", g_expire_algorithm.effective_keys_per_active_loop);
     if (reply != NULL) {
         switch (RedisModule_CallReplyType(reply)) {
             case REDISMODULE_REPLY_ARRAY: {
@@ -115,7 +148,7 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
     }
 
     /* 3. Delete expired field. */
-    int expire_keys_per_loop = g_expire_algorithm.keys_per_active_loop;
+    int expire_keys_per_loop = g_expire_algorithm.effective_keys_per_active_loop;
     m_listNode *node;
     while ((node = listFirst(keys)) != NULL) {
         key = listNodeValue(node);
@@ -137,6 +170,10 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
         }
 
         tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
+        if (keyExpireIfNeeded(ctx, dbid, real_key, key, tair_hash_obj, 1)) {
+            m_listDelNode(keys, node);
+            continue;
+        }
         if (dictSize(tair_hash_obj->hash) == 1) {
             may_delkey = 1;
         }
@@ -175,7 +212,7 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
         }
 
         if (start_index) {
-            m_zslDeleteRangeByRank(tair_hash_obj->expire_index, 1, start_index);
+            m_zslDeleteHead(tair_hash_obj->expire_index, start_index);
             delEmptyTairHashIfNeeded(ctx, NULL, key, tair_hash_obj);
         }
         m_listDelNode(keys, node);
@@ -185,101 +222,53 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
 
 void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *key) {
     tairHashObj *tair_hash_obj = NULL;
-    long long when, now;
-    int start_index = 0;
-    m_zskiplistNode *ln = NULL;
-
-    RedisModuleString *field;
-    RedisModuleKey *real_key;
-    unsigned long zsl_len;
-    int may_delkey = 0;
-    /* 1. The current db does not have a key that needs to expire. */
-    list *keys = m_listCreate();
+    m_zskiplistNode *ln = NULL, *next;
 
-    real_key = RedisModule_OpenKey(ctx, key, REDISMODULE_READ | REDISMODULE_WRITE);
-    if (RedisModule_KeyType(real_key) != REDISMODULE_KEYTYPE_EMPTY && RedisModule_ModuleTypeGetType(real_key) == TairHashType) {
-        tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
-        if (tair_hash_obj->expire_index->length > 0) {
-            m_listAddNodeTail(keys, key);
-        }
+    /* The key is opened once, expired fields remove their own index entries. */
+    RedisModuleKey *real_key = RedisModule_OpenKey(ctx, key, REDISMODULE_READ | REDISMODULE_WRITE);
+    if (RedisModule_KeyType(real_key) == REDISMODULE_KEYTYPE_EMPTY || RedisModule_ModuleTypeGetType(real_key) != TairHashType) {
+        RedisModule_CloseKey(real_key);
+        return;
     }
-    RedisModule_CloseKey(real_key);
 
-    if (listLength(keys) == 0) {
-        m_listRelease(keys);
+    tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
+    if (tair_hash_obj->expire_index->length == 0) {
+        RedisModule_CloseKey(real_key);
         return;
     }
 
-    /* 3. Delete expired field. */
-    int keys_per_loop = g_expire_algorithm.keys_per_passive_loop;
-    m_listNode *node;
-    while ((node = listFirst(keys)) != NULL) {
-        key = listNodeValue(node);
-        may_delkey = 0;
-        real_key = RedisModule_OpenKey(ctx, key, REDISMODULE_READ | REDISMODULE_WRITE);
-        int type = RedisModule_KeyType(real_key);
-
-        Module_Assert(type != REDISMODULE_KEYTYPE_EMPTY && RedisModule_ModuleTypeGetType(real_key) == TairHashType);
-        tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
-
-        zsl_len = tair_hash_obj->expire_index->length;
-        Module_Assert(zsl_len > 0);
+    if (keyExpireIfNeeded(ctx, dbid, real_key, key, tair_hash_obj, 0)) {
+        return;
+    }
 
-        mstime_t key_ttl = RedisModule_GetExpire(real_key);
-        if (key_ttl != REDISMODULE_NO_EXPIRE && key_ttl < 100) { // 100ms
-            may_delkey = 1;
+    int keys_per_loop = g_expire_algorithm.effective_keys_per_passive_loop;
+    ln = tair_hash_obj->expire_index->header->level[0].forward;
+    while (ln && keys_per_loop) {
+        next = ln->level[0].forward;
+        if (!fieldExpireIfNeeded(ctx, dbid, key, tair_hash_obj, ln->member, 0)) {
+            break;
         }
+        g_expire_algorithm.stat_passive_expired_field[dbid]++;
+        keys_per_loop--;
+        ln = next;
+    }
 
-        tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
-        if (dictSize(tair_hash_obj->hash) == 1) {
-            may_delkey = 1;
-        }
+    if (!delEmptyTairHashIfNeeded(ctx, real_key, key, tair_hash_obj)) {
         RedisModule_CloseKey(real_key);
-
-        start_index = 0;
-        ln = tair_hash_obj->expire_index->header->level[0].forward;
-        while (ln && keys_per_loop) {
-            field = ln->member;
-            if (fieldExpireIfNeeded(ctx, dbid, key, tair_hash_obj, field, 0)) {
-                g_expire_algorithm.stat_passive_expired_field[dbid]++;
-                start_index++;
-                keys_per_loop--;
-                if (may_delkey) {
-                    break;
-                }
-            } else {
-                break;
-            }
-            ln = ln->level[0].forward;
-        }
-
-        if (may_delkey) {
-            real_key = RedisModule_OpenKey(ctx, key, REDISMODULE_READ | REDISMODULE_OPEN_KEY_NOTOUCH);
-            int type = RedisModule_KeyType(real_key);
-            if (type == REDISMODULE_KEYTYPE_EMPTY) {
-                m_listDelNode(keys, node);
-                RedisModule_CloseKey(real_key);
-                continue;
-            } 
-            RedisModule_CloseKey(real_key);
-        }
-
-        if (start_index) {
-            m_zslDeleteRangeByRank(tair_hash_obj->expire_index, 1, start_index);
-            delEmptyTairHashIfNeeded(ctx, NULL, key, tair_hash_obj);
-        }
-        m_listDelNode(keys, node);
     }
-
-    m_listRelease(keys);
 }
 
 void deleteAndPropagate(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *obj, RedisModuleString *field, long long expire, int is_timer) {
-    if (is_timer) {
-        /* See bugfix: https://github.com/redis/redis/pull/8617
-                       https://github.com/redis/redis/pull/8097
-                       https://github.com/redis/redis/pull/7037
-        */
+    if (is_timer && canPropagateInTimer()) {
+        /* The expire index only borrows `field` and will be trimmed by the caller in
+         * batch, `field` is released by the dict delete so propagate it first. Until
+         * then the tail of the index is still an upper bound of the expires. */
+        expireFieldRemoved(obj, expire);
+        RedisModule_Replicate(ctx, "EXHDEL", "ss", key, field);
+        notifyFieldSpaceEvent("expired", key, field, dbid);
+        tairHashDeleteField(ctx, obj, field);
+    } else if (is_timer) {
+        expireFieldRemoved(obj, expire);
         RedisModuleCtx *ctx2 = RedisModule_GetThreadSafeContext(NULL);
         RedisModule_SelectDb(ctx2, dbid);
         notifyFieldSpaceEvent("expired", key, field, dbid);
@@ -291,8 +280,9 @@ void deleteAndPropagate(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, t
     } else {
         RedisModuleString *key_dup = RedisModule_CreateStringFromString(NULL, key);
         RedisModuleString *field_dup = RedisModule_CreateStringFromString(NULL, field);
-        m_zslDelete(obj->expire_index, expire, field_dup, NULL);
-        m_dictDelete(obj->hash, field);
+        m_zslDelete(obj->expire_index, expire, field);
+        expireFieldRemoved(obj, expire);
+        tairHashDeleteField(ctx, obj, field);
         RedisModule_Replicate(ctx, "EXHDEL", "ss", key_dup, field_dup);
         notifyFieldSpaceEvent("expired", key_dup, field_dup, dbid);
         RedisModule_FreeString(NULL, key_dup);
@@ -53,7 +53,7 @@ int slab_getNode(Slab *slab, RedisModuleString *key, long long expire) {
     }
 
     for (int i = 0; i < num_keys; i++) {
-        if (slab->expires[i] == expire && RedisModule_StringCompare(key, slab->keys[i]) == 0) {
+        if (slab->expires[i] == expire && slab_keyCompare(key, slab->keys[i]) == 0) {
             target_position = i;
             break;
         }
@@ -67,7 +67,6 @@ int slab_deleteIndexNode(Slab *slab, int index) {
         return FALSE;
     }
     int end = slab->num_keys - 1;
-    RedisModule_FreeString(NULL, slab->keys[index]);
     if (end != index) {
         slab->keys[index] = slab->keys[end], slab->expires[index] = slab->expires[end];
     }
@@ -87,7 +86,6 @@ int slab_updateNode(Slab *slab, RedisModuleString *cur_key, long long cur_expire
         return FALSE;
     }
 
-    RedisModule_FreeString(NULL, slab->keys[target_position]);
     slab->keys[target_position] = new_key, slab->expires[target_position] = new_expire;
 
     return TRUE;
@@ -96,9 +94,6 @@ int slab_updateNode(Slab *slab, RedisModuleString *cur_key, long long cur_expire
 /* free slab */
 void slab_delete(Slab *slab) {
     if (slab == NULL) return;
-    for (int i = 0; i < slab->num_keys; i++) {
-        RedisModule_FreeString(NULL, slab->keys[i]);
-    }
     RedisModule_Free(slab);
 }
 
@@ -106,7 +101,7 @@ void slab_delete(Slab *slab) {
 int slab_minExpireTimeIndex(Slab *slab) {
     int min_subscript = 0, length = slab->num_keys;
     for (int i = 1; i < length; i++) {
-        if (slab->expires[min_subscript] > slab->expires[i] || (slab->expires[min_subscript] == slab->expires[i] && RedisModule_StringCompare(slab->keys[min_subscript], slab->keys[i]) > 0)) {
+        if (slab->expires[min_subscript] > slab->expires[i] || (slab->expires[min_subscript] == slab->expires[i] && slab_keyCompare(slab->keys[min_subscript], slab->keys[i]) > 0)) {
             min_subscript = i;
         }
     }
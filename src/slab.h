@@ -26,10 +26,16 @@
 #define TRUE 1
 typedef struct Slab {
     long long expires[SLABMAXN];        // field_value_expire
-    RedisModuleString *keys[SLABMAXN];  // field
+    RedisModuleString *keys[SLABMAXN];  // field, borrowed from the hash dict
     uint16_t num_keys;
 } Slab;
 
+/* Keys are ordered by pointer, ties between equal expires never touch the strings,
+ * which may already have been released by the hash when a slab is trimmed. */
+static inline int slab_keyCompare(RedisModuleString *a, RedisModuleString *b) {
+    return (uintptr_t)a < (uintptr_t)b ? -1 : ((uintptr_t)a > (uintptr_t)b);
+}
+
 Slab *slab_createNode(void);
 int slab_insertNode(Slab *slab, RedisModuleString *key, long long expire);
 int slab_getNode(Slab *slab, RedisModuleString *key, long long expire);
@@ -15,9 +15,11 @@
  */
 #include "tairhash.h"
 
+#include <string.h>
+
 #if defined(SLAB_MODE)
 extern ExpireAlgorithm g_expire_algorithm;
-extern m_zskiplist *g_expire_index[DB_NUM];
+extern m_zskiplist **g_expire_index;
 extern RedisModuleType *TairHashType;
 
 int ontime_indices[SLABMAXN], timeout_indices[SLABMAXN];
@@ -26,17 +28,9 @@ void insert(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *
     REDISMODULE_NOT_USED(ctx);
     REDISMODULE_NOT_USED(key);
     if (expire) {
-        long long before_min_score = -1, after_min_score = -1;
-        if (o->expire_index->header->level[0].forward) {
-            before_min_score = o->expire_index->header->level[0].forward->expire_min;
-        }
-        slab_expireInsert(o->expire_index, takeAndRef(field), expire);
-        after_min_score = o->expire_index->header->level[0].forward->expire_min;
-        if (before_min_score > 0) {
-            m_zslUpdateScore(g_expire_index[dbid], before_min_score, o->key, after_min_score);
-        } else {
-            m_zslInsert(g_expire_index[dbid], after_min_score, takeAndRef(o->key));
-        }
+        slab_expireInsert(o->expire_index, field, expire);
+        expireFieldAdded(o, expire);
+        globalExpireIndexUpdate(dbid, o, o->expire_index->header->level[0].forward->expire_min);
     }
 }
 
@@ -44,33 +38,89 @@ void update(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *
     REDISMODULE_NOT_USED(ctx);
     REDISMODULE_NOT_USED(key);
     if (cur_expire != new_expire) {
-        long long before_min_score = -1, after_min_score = 1;
-        tairhash_zskiplistNode *ln = o->expire_index->header->level[0].forward;
-        Module_Assert(ln != NULL);
-        before_min_score = ln->expire_min;
-        RedisModuleString *new_field = takeAndRef(field);
-        slab_expireUpdate(o->expire_index, field, cur_expire, new_field, new_expire);
-        after_min_score = o->expire_index->header->level[0].forward->expire_min;
-        m_zslUpdateScore(g_expire_index[dbid], before_min_score, o->key, after_min_score);
+        Module_Assert(o->expire_index->header->level[0].forward != NULL);
+        slab_expireUpdate(o->expire_index, field, cur_expire, field, new_expire);
+        expireFieldUpdated(o, cur_expire, new_expire);
+        globalExpireIndexUpdate(dbid, o, o->expire_index->header->level[0].forward->expire_min);
     }
 }
 
 void delete(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, long long cur_expire) {
     REDISMODULE_NOT_USED(ctx);
+    REDISMODULE_NOT_USED(dbid);
     REDISMODULE_NOT_USED(key);
     if (cur_expire != 0) {
-        long long before_min_score = -1;
-        tairhash_zskiplistNode *ln = o->expire_index->header->level[0].forward;
-        Module_Assert(ln != NULL);
-        before_min_score = ln->expire_min;
+        /* The global index entry of the key is left as it is, it is still a lower bound. */
         slab_expireDelete(o->expire_index, field, cur_expire);
-        if (o->expire_index->header->level[0].forward) {
-            long long after_min_score = o->expire_index->header->level[0].forward->expire_min;
-            m_zslUpdateScore(g_expire_index[dbid], before_min_score, key, after_min_score);
-        } else {
-            m_zslDelete(g_expire_index[dbid], before_min_score, key, NULL);
+        expireFieldRemoved(o, cur_expire);
+    }
+}
+
+/* The entries of a slab are not sorted, the tail slab is only walked when the entry
+ * that left may have been the latest one. */
+long long maxExpire(tairHashObj *o, long long cur_expire) {
+    if (cur_expire < o->max_expire) {
+        return o->max_expire;
+    }
+    tairhash_zskiplistNode *tail = o->expire_index->tail;
+    long long max = 0;
+    for (int i = 0; tail && i < tail->slab->num_keys; i++) {
+        if (tail->slab->expires[i] > max) {
+            max = tail->slab->expires[i];
+        }
+    }
+    return max;
+}
+
+/* Slabs split the expire space into consecutive ranges but the entries of a slab are
+ * not sorted, whole slabs are collected until `limit` is reached and sorted at the end. */
+size_t rangeByExpire(tairHashObj *o, long long min, long long max, long long *expires, RedisModuleString **fields, size_t limit) {
+    tairhash_zskiplist *zsl = o->expire_index;
+    /* The last slab starting below `min` may still hold entries >= `min`. */
+    tairhash_zskiplistNode *node = tairhash_zslGetNode(zsl, NULL, min);
+    if (node == zsl->header) {
+        node = node->level[0].forward;
+    }
+
+    size_t n = 0, cap = limit + SLABMAXN;
+    long long *buf_expires = RedisModule_Alloc(cap * sizeof(long long));
+    RedisModuleString **buf_fields = RedisModule_Alloc(cap * sizeof(RedisModuleString *));
+    while (node && node->expire_min <= max && n < limit) {
+        Slab *slab = node->slab;
+        for (int i = 0; i < slab->num_keys; i++) {
+            if (slab->expires[i] >= min && slab->expires[i] <= max) {
+                buf_expires[n] = slab->expires[i];
+                buf_fields[n++] = slab->keys[i];
+            }
+        }
+        node = node->level[0].forward;
+    }
+
+    m_btreeSortEntries(buf_expires, buf_fields, n);
+    if (n > limit) {
+        n = limit;
+    }
+    memcpy(expires, buf_expires, n * sizeof(long long));
+    memcpy(fields, buf_fields, n * sizeof(RedisModuleString *));
+    RedisModule_Free(buf_expires);
+    RedisModule_Free(buf_fields);
+    return n;
+}
+
+unsigned long countExpired(tairHashObj *o, long long now) {
+    tairhash_zskiplist *zsl = o->expire_index;
+    tairhash_zskiplistNode *node = zsl->header->level[0].forward;
+    unsigned long n = 0;
+    while (node && node->expire_min < now) {
+        Slab *slab = node->slab;
+        for (int i = 0; i < slab->num_keys; i++) {
+            if (slab->expires[i] < now) {
+                n++;
+            }
         }
+        node = node->level[0].forward;
     }
+    return n;
 }
 
 void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
@@ -111,7 +161,7 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
 
     if (start_index) {
         /* It is assumed that these keys will all be deleted. */
-        m_zslDeleteRangeByRank(g_expire_index[dbid], 1, start_index);
+        m_zslDeleteHead(g_expire_index[dbid], start_index);
     }
 
     if (listLength(keys) == 0) {
@@ -134,9 +184,19 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
             continue;
         }
         tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
+        /* The entry has been popped, the key is re-indexed below if it still has fields to expire. */
+        tair_hash_obj->global_expire_score = 0;
+        if (keyExpireIfNeeded(ctx, dbid, real_key, key, tair_hash_obj, 1)) {
+            m_listDelNode(keys, node);
+            continue;
+        }
 
         zsl_len = tair_hash_obj->expire_index->length;
-        Module_Assert(zsl_len > 0);
+        if (zsl_len == 0) {
+            /* A stale entry, all the fields with expire have been deleted or persisted. */
+            m_listDelNode(keys, node);
+            continue;
+        }
 
         ln2 = tair_hash_obj->expire_index->header->level[0].forward;
         start_index = 0, delete_rank = 0;
@@ -179,8 +239,8 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
             slab_deleteSlabExpire(tair_hash_obj->expire_index, tair_hash_obj->expire_index->header->level[0].forward, ontime_indices, ontime_num);
         }
 
-        if (tair_hash_obj->expire_index->length > 0 && start_index) {
-            m_zslInsert(g_expire_index[dbid], tair_hash_obj->expire_index->header->level[0].forward->expire_min, takeAndRef(tair_hash_obj->key));
+        if (tair_hash_obj->expire_index->length > 0) {
+            globalExpireIndexUpdate(dbid, tair_hash_obj, tair_hash_obj->expire_index->header->level[0].forward->expire_min);
         }
         if (start_index) {
             delEmptyTairHashIfNeeded(ctx, real_key, key, tair_hash_obj);
@@ -203,16 +263,10 @@ void deleteAndPropagate(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, t
     RedisModuleString *key_dup = RedisModule_CreateStringFromString(NULL, key);
     RedisModuleString *field_dup = RedisModule_CreateStringFromString(NULL, field);
     if (!is_timer) {
-        long long before_min_score = o->expire_index->header->level[0].forward->expire_min;
-        slab_expireDelete(o->expire_index, field_dup, expire);
-        if (o->expire_index->header->level[0].forward != NULL) {
-            long long after_min_score = o->expire_index->header->level[0].forward->expire_min;
-            m_zslUpdateScore(g_expire_index[dbid], before_min_score, key, after_min_score);
-        } else {
-            m_zslDelete(g_expire_index[dbid], before_min_score, key, NULL);
-        }
+        slab_expireDelete(o->expire_index, field, expire);
     }
-    m_dictDelete(o->hash, field);
+    expireFieldRemoved(o, expire);
+    tairHashDeleteField(ctx, o, field);
     RedisModule_Replicate(ctx, "EXHDEL", "ss", key_dup, field_dup);
     notifyFieldSpaceEvent("expired", key_dup, field_dup, dbid);
     RedisModule_FreeString(NULL, key_dup);
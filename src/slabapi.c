@@ -35,11 +35,11 @@ int partition(Slab *slab, int low, int high) {
     long long expire = slab->expires[low];
     RedisModuleString *key = slab->keys[low];
     while (low < high) {
-        while (low < high && (slab->expires[high] > expire || (slab->expires[high] == expire && RedisModule_StringCompare(slab->keys[high], key) >= 0)))
+        while (low < high && (slab->expires[high] > expire || (slab->expires[high] == expire && slab_keyCompare(slab->keys[high], key) >= 0)))
             high--;
         if (low < high)
             slab->expires[low] = slab->expires[high], slab->keys[low++] = slab->keys[high];
-        while (low < high && (slab->expires[low] < expire || (slab->expires[low] == expire && RedisModule_StringCompare(slab->keys[low], key) < 0)))
+        while (low < high && (slab->expires[low] < expire || (slab->expires[low] == expire && slab_keyCompare(slab->keys[low], key) < 0)))
             low++;
         if (low < high)
             slab->expires[high] = slab->expires[low], slab->keys[high--] = slab->keys[low];
@@ -67,10 +67,10 @@ int quick_selectRelaxtopk(Slab *slab, int left, int right, int kth) {
     RedisModuleString *pivot_key = slab->keys[mid];
     slab_swap(slab, left, mid);
     while (i != j) {
-        while (j > i && (slab->expires[j] > pivot_expire || (slab->expires[j] == pivot_expire && RedisModule_StringCompare(slab->keys[j], pivot_key) >= 0)))
+        while (j > i && (slab->expires[j] > pivot_expire || (slab->expires[j] == pivot_expire && slab_keyCompare(slab->keys[j], pivot_key) >= 0)))
             --j;
         slab->expires[i] = slab->expires[j], slab->keys[i] = slab->keys[j];
-        while (i < j && (slab->expires[i] < pivot_expire || (slab->expires[i] == pivot_expire && RedisModule_StringCompare(slab->keys[i], pivot_key) <= 0)))
+        while (i < j && (slab->expires[i] < pivot_expire || (slab->expires[i] == pivot_expire && slab_keyCompare(slab->keys[i], pivot_key) <= 0)))
             ++i;
         slab->expires[j] = slab->expires[i], slab->keys[j] = slab->keys[i];
     }
@@ -153,7 +153,13 @@ tairhash_zskiplistNode *slab_split(tairhash_zskiplist *zsl, tairhash_zskiplistNo
 }
 
 void slab_expireInsert(tairhash_zskiplist *zsl, RedisModuleString *key, long long expire) {
-    tairhash_zskiplistNode *find_node = tairhash_zslGetNode(zsl, key, expire);
+    tairhash_zskiplistNode *find_node;
+    tairhash_zskiplistNode *tail = zsl->tail;
+    if (tail != NULL && (tail->expire_min < expire || (tail->expire_min == expire && slab_keyCompare(tail->key_min, key) <= 0))) {
+        find_node = tail;  // append fast path, everything after the last slab's min belongs to the last slab
+    } else {
+        find_node = tairhash_zslGetNode(zsl, key, expire);
+    }
     int insert_ans = FALSE;
     if (find_node == zsl->header) {                 // no node insert
         find_node = zsl->header->level[0].forward;  // try to insert first skiplistNode
@@ -163,7 +169,7 @@ void slab_expireInsert(tairhash_zskiplist *zsl, RedisModuleString *key, long lon
     {
         tairhash_zskiplistNode *new_tair_hash_node = slab_split(zsl, find_node);
         if (new_tair_hash_node->expire_min < expire || (new_tair_hash_node->expire_min == expire  // insert  new slab
-                                                        && RedisModule_StringCompare(new_tair_hash_node->key_min, key) < 0)) {
+                                                        && slab_keyCompare(new_tair_hash_node->key_min, key) < 0)) {
             find_node = new_tair_hash_node;
             Slab *new_slab = find_node->slab;
             insert_ans = slab_insertNode(new_slab, key, expire);
@@ -175,7 +181,7 @@ void slab_expireInsert(tairhash_zskiplist *zsl, RedisModuleString *key, long lon
         Slab *find_slab = find_node->slab;
         insert_ans = slab_insertNode(find_slab, key, expire);
         assert(insert_ans == TRUE);
-        if (find_node->expire_min > expire || (find_node->expire_min == expire && RedisModule_StringCompare(find_node->key_min, key) > 0)) {  // update tairhashskiplist
+        if (find_node->expire_min > expire || (find_node->expire_min == expire && slab_keyCompare(find_node->key_min, key) > 0)) {  // update tairhashskiplist
             find_node->expire_min = expire, find_node->key_min = key;
         }
     }
@@ -196,7 +202,7 @@ void slab_expireDelete(tairhash_zskiplist *zsl, RedisModuleString *key, long lon
     Slab *find_slab = find_node->slab;
     assert(find_slab->num_keys != 0);
     if (find_slab->num_keys == 1) {
-        assert(find_slab->expires[0] == expire && RedisModule_StringCompare(find_slab->keys[0], key) == 0);
+        assert(find_slab->expires[0] == expire && slab_keyCompare(find_slab->keys[0], key) == 0);
         Slab *new_slab = find_slab;
         int delete_ans = tairhash_zslDelete(zsl, key, expire);
         assert(delete_ans == 1);
@@ -205,7 +211,7 @@ void slab_expireDelete(tairhash_zskiplist *zsl, RedisModuleString *key, long lon
     }
 
     int update_findNode = FALSE, delete_ans = FALSE;
-    if (find_node->expire_min == expire && RedisModule_StringCompare(find_node->key_min, key) == 0)
+    if (find_node->expire_min == expire && slab_keyCompare(find_node->key_min, key) == 0)
         update_findNode = TRUE;
     delete_ans = slab_deleteNode(find_slab, key, expire);
     assert(delete_ans == TRUE);
@@ -263,7 +269,7 @@ void slab_deleteSlabExpire(tairhash_zskiplist *zsl, tairhash_zskiplistNode *zsl_
         index = effective_indexs[i];
         slab->expires[i] = slab->expires[index];
         slab->keys[i] = slab->keys[index];
-        if (slab->expires[i] < slab->expires[min_index] || (slab->expires[i] == slab->expires[min_index] && RedisModule_StringCompare(slab->keys[i], slab->keys[min_index]) <= 0)) {
+        if (slab->expires[i] < slab->expires[min_index] || (slab->expires[i] == slab->expires[min_index] && slab_keyCompare(slab->keys[i], slab->keys[min_index]) <= 0)) {
             min_index = i;
         }
     }
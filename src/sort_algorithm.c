@@ -15,26 +15,290 @@
  */
 #include "tairhash.h"
 
+#include "indexthread.h"
+
 #if defined(SORT_MODE)
 extern ExpireAlgorithm g_expire_algorithm;
-extern m_zskiplist *g_expire_index[DB_NUM];
+extern m_zskiplist **g_expire_index;
 extern RedisModuleType *TairHashType;
 
+/* With `expire_granularity` > 1 fields are indexed by the end of the time bucket
+ * they fall in, so all the fields of a due bucket are really expired and fields
+ * of the same bucket share one index node. Reads still check the exact expire. */
+static inline long long expireBucket(long long expire) {
+    long long granularity = (long long)g_expire_algorithm.expire_granularity;
+    if (granularity <= 1) {
+        return expire;
+    }
+    return (expire + granularity - 1) / granularity * granularity;
+}
+
+static void fieldIndexInsert(m_zskiplist *zsl, long long expire, RedisModuleString *field) {
+    if (g_expire_algorithm.expire_granularity > 1) {
+        m_zslBucketInsert(zsl, expireBucket(expire), field);
+    } else {
+        m_zslInsert(zsl, expire, field);
+    }
+}
+
+static void fieldIndexDelete(m_zskiplist *zsl, long long expire, RedisModuleString *field) {
+    if (g_expire_algorithm.expire_granularity > 1) {
+        m_zslBucketDelete(zsl, expireBucket(expire), field);
+    } else {
+        m_zslDelete(zsl, expire, field);
+    }
+}
+
+#define FIELD_INDEX_INSERT 0
+#define FIELD_INDEX_UPDATE 1
+#define FIELD_INDEX_DELETE 2
+#define FIELD_INDEX_FREE 3
+
+/* A change to the field index of a key, queued to the index thread with `index_thread`. */
+typedef struct fieldIndexJob {
+    indexJob job;
+    int type;
+    m_zskiplist *zsl;
+    RedisModuleString *field;
+    long long cur_expire, new_expire;
+} fieldIndexJob;
+
+static void fieldIndexApply(int type, m_zskiplist *zsl, RedisModuleString *field, long long cur_expire, long long new_expire) {
+    switch (type) {
+    case FIELD_INDEX_INSERT:
+        fieldIndexInsert(zsl, new_expire, field);
+        break;
+    case FIELD_INDEX_UPDATE:
+        if (g_expire_algorithm.expire_granularity > 1) {
+            fieldIndexDelete(zsl, cur_expire, field);
+            fieldIndexInsert(zsl, new_expire, field);
+        } else {
+            m_zslUpdateScore(zsl, cur_expire, field, new_expire);
+        }
+        break;
+    case FIELD_INDEX_DELETE:
+        fieldIndexDelete(zsl, cur_expire, field);
+        break;
+    case FIELD_INDEX_FREE:
+        m_zslFree(zsl);
+        break;
+    }
+}
+
+static void fieldIndexJobRun(indexJob *job) {
+    fieldIndexJob *j = (fieldIndexJob *)job;
+    fieldIndexApply(j->type, j->zsl, j->field, j->cur_expire, j->new_expire);
+    RedisModule_Free(j);
+}
+
+/* Apply a change to a field index, with `index_thread` the indexes belong to the index
+ * thread and the change is only queued. Fields are compared by pointer there, a field
+ * released after queueing its deletion is never dereferenced. */
+static void fieldIndexChange(int type, m_zskiplist *zsl, RedisModuleString *field, long long cur_expire, long long new_expire) {
+    if (!g_expire_algorithm.index_thread) {
+        fieldIndexApply(type, zsl, field, cur_expire, new_expire);
+        return;
+    }
+
+    fieldIndexJob *j = RedisModule_Alloc(sizeof(*j));
+    j->job.run = fieldIndexJobRun;
+    j->type = type;
+    j->zsl = zsl;
+    j->field = field;
+    j->cur_expire = cur_expire;
+    j->new_expire = new_expire;
+    indexThreadSubmit(&j->job);
+}
+
+/* Release the field index of a key, this may be called by the redis lazyfree thread. */
+void fieldIndexFree(m_zskiplist *zsl) {
+    fieldIndexChange(FIELD_INDEX_FREE, zsl, NULL, 0, 0);
+}
+
+static long long fieldIndexHead(m_zskiplist *zsl) {
+    m_zskiplistNode *ln = zsl->header->level[0].forward;
+    return ln ? ln->score : 0;
+}
+
+typedef struct minExpireJob {
+    indexJob job;
+    m_zskiplist *zsl;
+    long long expire;
+} minExpireJob;
+
+static void minExpireJobRun(indexJob *job) {
+    minExpireJob *j = (minExpireJob *)job;
+    j->expire = fieldIndexHead(j->zsl);
+    indexThreadJobDone(job);
+}
+
+/* Earliest (bucketed) expire in the field index of `o`, 0 if it is empty. */
+long long fieldIndexMinExpire(tairHashObj *o) {
+    if (!g_expire_algorithm.index_thread) {
+        return fieldIndexHead(o->expire_index);
+    }
+
+    minExpireJob j;
+    j.job.run = minExpireJobRun;
+    j.zsl = o->expire_index;
+    indexThreadRun(&j.job);
+    return j.expire;
+}
+
+/* Pop the due fields of several field indexes in the index thread, at most `budget` in
+ * total. The caller waits for the job, so none of the fields can be released meanwhile. */
+typedef struct dueFieldsJob {
+    indexJob job;
+    m_zskiplist **indexes;
+    size_t numkeys;
+    long long now;
+    size_t budget;
+    RedisModuleString **fields; /* `budget` slots, the fields of each index one after another. */
+    size_t *counts;             /* Number of fields popped from each index. */
+    long long *next_expire;     /* Earliest expire left in each index, 0 if it is empty. */
+} dueFieldsJob;
+
+static void dueFieldsJobRun(indexJob *job) {
+    dueFieldsJob *j = (dueFieldsJob *)job;
+    size_t n = 0;
+
+    for (size_t i = 0; i < j->numkeys; i++) {
+        m_zskiplist *zsl = j->indexes[i];
+        m_zskiplistNode *ln = zsl->header->level[0].forward;
+        size_t start = n;
+        unsigned long nodes = 0;
+        while (ln && ln->score <= j->now && n < j->budget) {
+            RedisModuleString *member;
+            while (n < j->budget && (member = m_zslBucketPop(ln)) != NULL) {
+                j->fields[n++] = member;
+            }
+            if (n == j->budget) {
+                break;
+            }
+            j->fields[n++] = ln->member;
+            nodes++;
+            ln = ln->level[0].forward;
+        }
+        if (nodes) {
+            m_zslDeleteHead(zsl, nodes);
+        }
+        j->counts[i] = n - start;
+        j->next_expire[i] = fieldIndexHead(zsl);
+    }
+    indexThreadJobDone(job);
+}
+
+/* The expire cycles with `index_thread`: open all the popped keys, ask the index thread
+ * for their due fields in one round trip, then expire them and re-index the keys. */
+static void expireKeysWithIndexThread(RedisModuleCtx *ctx, int dbid, list *keys, size_t budget, int is_active, uint64_t *stat) {
+    size_t numkeys = listLength(keys), k = 0;
+    RedisModuleKey **real_keys = RedisModule_Alloc(numkeys * sizeof(RedisModuleKey *));
+    RedisModuleString **names = RedisModule_Alloc(numkeys * sizeof(RedisModuleString *));
+    tairHashObj **objs = RedisModule_Alloc(numkeys * sizeof(tairHashObj *));
+    m_zskiplist **indexes = RedisModule_Alloc(numkeys * sizeof(m_zskiplist *));
+
+    m_listNode *node;
+    while ((node = listFirst(keys)) != NULL) {
+        RedisModuleString *key = listNodeValue(node);
+        m_listDelNode(keys, node);
+        int flags = REDISMODULE_READ | REDISMODULE_WRITE | (is_active ? REDISMODULE_OPEN_KEY_NOTOUCH : 0);
+        RedisModuleKey *real_key = RedisModule_OpenKey(ctx, key, flags);
+        if (RedisModule_KeyType(real_key) == REDISMODULE_KEYTYPE_EMPTY) {
+            RedisModule_CloseKey(real_key);
+            continue;
+        }
+        Module_Assert(RedisModule_ModuleTypeGetType(real_key) == TairHashType);
+
+        tairHashObj *o = RedisModule_ModuleTypeGetValue(real_key);
+        /* The entry has been popped, the key is re-indexed below if it still has fields to expire. */
+        o->global_expire_score = 0;
+        if (keyExpireIfNeeded(ctx, dbid, real_key, key, o, is_active)) {
+            continue;
+        }
+        if (o->expire_fields == 0) {
+            /* A stale entry, all the fields with expire have been deleted or persisted. */
+            RedisModule_CloseKey(real_key);
+            continue;
+        }
+        real_keys[k] = real_key;
+        names[k] = key;
+        objs[k] = o;
+        indexes[k] = o->expire_index;
+        k++;
+    }
+
+    dueFieldsJob job;
+    job.indexes = indexes;
+    job.numkeys = k;
+    job.now = RedisModule_Milliseconds();
+    job.budget = budget;
+    job.fields = RedisModule_Alloc(budget * sizeof(RedisModuleString *));
+    job.counts = RedisModule_Alloc(k * sizeof(size_t));
+    job.next_expire = RedisModule_Alloc(k * sizeof(long long));
+    job.job.run = dueFieldsJobRun;
+    if (k) {
+        indexThreadRun(&job.job);
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < k; i++) {
+        long long next_expire = job.next_expire[i];
+        for (size_t f = 0; f < job.counts[i]; f++) {
+            RedisModuleString *field = job.fields[pos++];
+            if (fieldExpireIfNeeded(ctx, dbid, names[i], objs[i], field, 1)) {
+                (*stat)++;
+                continue;
+            }
+            /* Not expired after all, give it back to the index. */
+            TairHashVal *val = m_dictFetchValue(objs[i]->hash, field);
+            if (val && val->expire) {
+                fieldIndexChange(FIELD_INDEX_INSERT, objs[i]->expire_index, field, 0, val->expire);
+                if (next_expire == 0 || expireBucket(val->expire) < next_expire) {
+                    next_expire = expireBucket(val->expire);
+                }
+            }
+        }
+
+        if (next_expire) {
+            globalExpireIndexUpdate(dbid, objs[i], next_expire);
+        }
+        if (!delEmptyTairHashIfNeeded(ctx, real_keys[i], names[i], objs[i])) {
+            RedisModule_CloseKey(real_keys[i]);
+        }
+    }
+
+    RedisModule_Free(job.fields);
+    RedisModule_Free(job.counts);
+    RedisModule_Free(job.next_expire);
+    RedisModule_Free(real_keys);
+    RedisModule_Free(names);
+    RedisModule_Free(objs);
+    RedisModule_Free(indexes);
+}
+
+/* Expire the extra fields of a bucket node from its tail, returns 1 if all of them
+ * have been expired, 0 if we ran out of budget or met a field that is still alive. */
+static int bucketExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, m_zskiplistNode *ln, int *budget, uint64_t *stat) {
+    while (ln->bucket && *budget) {
+        RedisModuleString *field = ln->bucket->members[ln->bucket->len - 1];
+        if (!fieldExpireIfNeeded(ctx, dbid, key, o, field, 1)) {
+            return 0;
+        }
+        (*stat)++;
+        (*budget)--;
+        m_zslBucketPop(ln);
+    }
+    return ln->bucket == NULL;
+}
+
 void insert(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, long long expire) {
     REDISMODULE_NOT_USED(ctx);
     REDISMODULE_NOT_USED(key);
     if (expire) {
-        long long before_min_score = -1, after_min_score = -1;
-        if (o->expire_index->header->level[0].forward) {
-            before_min_score = o->expire_index->header->level[0].forward->score;
-        }
-        m_zslInsert(o->expire_index, expire, takeAndRef(field));
-        after_min_score = o->expire_index->header->level[0].forward->score;
-        if (before_min_score > 0) {
-            m_zslUpdateScore(g_expire_index[dbid], before_min_score, o->key, after_min_score);
-        } else {
-            m_zslInsert(g_expire_index[dbid], after_min_score, takeAndRef(o->key));
-        }
+        fieldIndexChange(FIELD_INDEX_INSERT, o->expire_index, field, 0, expire);
+        expireFieldAdded(o, expire);
+        /* The global score only moves earlier, so the new expire is all it needs. */
+        globalExpireIndexUpdate(dbid, o, expireBucket(expire));
     }
 }
 
@@ -42,32 +306,134 @@ void update(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *
     REDISMODULE_NOT_USED(ctx);
     REDISMODULE_NOT_USED(key);
     if (cur_expire != new_expire) {
-        long long before_min_score = -1, after_min_score = 1;
-        m_zskiplistNode *ln = o->expire_index->header->level[0].forward;
-        Module_Assert(ln != NULL);
-        before_min_score = ln->score;
-        m_zslUpdateScore(o->expire_index, cur_expire, field, new_expire);
-        after_min_score = o->expire_index->header->level[0].forward->score;
-        m_zslUpdateScore(g_expire_index[dbid], before_min_score, o->key, after_min_score);
+        if (expireBucket(cur_expire) == expireBucket(new_expire)) {
+            expireFieldUpdated(o, cur_expire, new_expire);
+            return;
+        }
+        fieldIndexChange(FIELD_INDEX_UPDATE, o->expire_index, field, cur_expire, new_expire);
+        expireFieldUpdated(o, cur_expire, new_expire);
+        globalExpireIndexUpdate(dbid, o, expireBucket(new_expire));
     }
 }
 
 void delete(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, long long cur_expire) {
     REDISMODULE_NOT_USED(ctx);
+    REDISMODULE_NOT_USED(dbid);
     REDISMODULE_NOT_USED(key);
     if (cur_expire != 0) {
-        long long before_min_score = -1;
-        m_zskiplistNode *ln = o->expire_index->header->level[0].forward;
-        Module_Assert(ln != NULL);
-        before_min_score = ln->score;
-        m_zslDelete(o->expire_index, cur_expire, field, NULL);
-        if (o->expire_index->header->level[0].forward) {
-            long long after_min_score = o->expire_index->header->level[0].forward->score;
-            m_zslUpdateScore(g_expire_index[dbid], before_min_score, key, after_min_score);
-        } else {
-            m_zslDelete(g_expire_index[dbid], before_min_score, key, NULL);
+        /* The global index entry of the key is left as it is, it is still a lower bound. */
+        fieldIndexChange(FIELD_INDEX_DELETE, o->expire_index, field, cur_expire, 0);
+        expireFieldRemoved(o, cur_expire);
+    }
+}
+
+/* The tail of the field index, bucketed up, bounds the expires of the key. With
+ * `index_thread` the index belongs to the thread, the bound is then only raised. */
+long long maxExpire(tairHashObj *o, long long cur_expire) {
+    REDISMODULE_NOT_USED(cur_expire);
+    if (g_expire_algorithm.index_thread) {
+        return o->max_expire;
+    }
+    return o->expire_index->tail ? o->expire_index->tail->score : 0;
+}
+
+/* With `expire_granularity` > 1 the window is matched against the time buckets of the
+ * fields, the fields of a bucket come in no particular order. */
+static size_t fieldIndexRange(m_zskiplist *zsl, long long min, long long max, long long *expires, RedisModuleString **fields, size_t limit) {
+    m_zrangespec range = {expireBucket(min), expireBucket(max), 0, 0};
+    m_zskiplistNode *ln = m_zslFirstInRange(zsl, &range);
+    size_t n = 0;
+    while (ln && ln->score <= range.max && n < limit) {
+        expires[n] = ln->score;
+        fields[n++] = ln->member;
+        for (unsigned int i = 0; ln->bucket && i < ln->bucket->len && n < limit; i++) {
+            expires[n] = ln->score;
+            fields[n++] = ln->bucket->members[i];
+        }
+        ln = ln->level[0].forward;
+    }
+    return n;
+}
+
+typedef struct rangeJob {
+    indexJob job;
+    m_zskiplist *zsl;
+    long long min, max;
+    long long *expires;
+    RedisModuleString **fields;
+    size_t limit, n;
+} rangeJob;
+
+static void rangeJobRun(indexJob *job) {
+    rangeJob *j = (rangeJob *)job;
+    j->n = fieldIndexRange(j->zsl, j->min, j->max, j->expires, j->fields, j->limit);
+    indexThreadJobDone(job);
+}
+
+size_t rangeByExpire(tairHashObj *o, long long min, long long max, long long *expires, RedisModuleString **fields, size_t limit) {
+    if (!g_expire_algorithm.index_thread) {
+        return fieldIndexRange(o->expire_index, min, max, expires, fields, limit);
+    }
+
+    rangeJob j;
+    j.job.run = rangeJobRun;
+    j.zsl = o->expire_index;
+    j.min = min;
+    j.max = max;
+    j.expires = expires;
+    j.fields = fields;
+    j.limit = limit;
+    indexThreadRun(&j.job);
+    return j.n;
+}
+
+/* The fields of the bucket holding `now` may have expired before it, their own expire
+ * is read from the hash. */
+static unsigned long fieldIndexCountExpired(tairHashObj *o, long long now) {
+    m_zskiplistNode *ln = o->expire_index->header->level[0].forward;
+    unsigned long n = 0;
+    while (ln && ln->score < now) {
+        n += 1 + (ln->bucket ? ln->bucket->len : 0);
+        ln = ln->level[0].forward;
+    }
+
+    if (ln && g_expire_algorithm.expire_granularity > 1 && ln->score == expireBucket(now)) {
+        for (unsigned int i = 0; i <= (ln->bucket ? ln->bucket->len : 0); i++) {
+            RedisModuleString *field = i == 0 ? ln->member : ln->bucket->members[i - 1];
+            TairHashVal *val = m_dictFetchValue(o->hash, field);
+            if (val && val->expire && val->expire < now) {
+                n++;
+            }
         }
     }
+    return n;
+}
+
+typedef struct countJob {
+    indexJob job;
+    tairHashObj *o;
+    long long now;
+    unsigned long n;
+} countJob;
+
+static void countJobRun(indexJob *job) {
+    countJob *j = (countJob *)job;
+    j->n = fieldIndexCountExpired(j->o, j->now);
+    indexThreadJobDone(job);
+}
+
+unsigned long countExpired(tairHashObj *o, long long now) {
+    if (!g_expire_algorithm.index_thread) {
+        return fieldIndexCountExpired(o, now);
+    }
+
+    /* The hash is only read by the job while the main thread waits for it. */
+    countJob j;
+    j.job.run = countJobRun;
+    j.o = o;
+    j.now = now;
+    indexThreadRun(&j.job);
+    return j.n;
 }
 
 void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
@@ -109,7 +475,7 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
 
     if (start_index) {
         /* It is assumed that these keys will all be deleted. */
-        m_zslDeleteRangeByRank(g_expire_index[dbid], 1, start_index);
+        m_zslDeleteHead(g_expire_index[dbid], start_index);
     }
 
     if (listLength(keys) == 0) {
@@ -118,6 +484,11 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
     }
 
     /* 3. Delete expired field. */
+    if (g_expire_algorithm.index_thread) {
+        expireKeysWithIndexThread(ctx, dbid, keys, keys_per_loop, 1, &g_expire_algorithm.stat_active_expired_field[dbid]);
+        m_listRelease(keys);
+        return;
+    }
     expire_keys_per_loop = keys_per_loop;
     m_listNode *node;
     while ((node = listFirst(keys)) != NULL) {
@@ -133,13 +504,27 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
         }
 
         tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
+        /* The entry has been popped, the key is re-indexed below if it still has fields to expire. */
+        tair_hash_obj->global_expire_score = 0;
+        if (keyExpireIfNeeded(ctx, dbid, real_key, key, tair_hash_obj, 1)) {
+            m_listDelNode(keys, node);
+            continue;
+        }
 
         zsl_len = tair_hash_obj->expire_index->length;
-        Module_Assert(zsl_len > 0);
+        if (zsl_len == 0) {
+            /* A stale entry, all the fields with expire have been deleted or persisted. */
+            m_listDelNode(keys, node);
+            continue;
+        }
 
         ln2 = tair_hash_obj->expire_index->header->level[0].forward;
         start_index = 0;
         while (ln2 && expire_keys_per_loop) {
+            /* A bucket only leaves the index once all of its fields are gone. */
+            if (!bucketExpireIfNeeded(ctx, dbid, key, tair_hash_obj, ln2, &expire_keys_per_loop, &g_expire_algorithm.stat_active_expired_field[dbid]) || !expire_keys_per_loop) {
+                break;
+            }
             field = ln2->member;
             if (fieldExpireIfNeeded(ctx, dbid, key, tair_hash_obj, field, 1)) {
                 g_expire_algorithm.stat_active_expired_field[dbid]++;
@@ -152,13 +537,13 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
         }
 
         if (start_index) {
-            m_zslDeleteRangeByRank(tair_hash_obj->expire_index, 1, start_index);
+            m_zslDeleteHead(tair_hash_obj->expire_index, start_index);
             delEmptyTairHashIfNeeded(ctx, real_key, key, tair_hash_obj);
         }
 
         /* If there is still a field waiting to expire and delete, re-insert it to the global index. */
         if (ln2) {
-            m_zslInsert(g_expire_index[dbid], ln2->score, takeAndRef(tair_hash_obj->key));
+            globalExpireIndexUpdate(dbid, tair_hash_obj, ln2->score);
         }
 
         m_listDelNode(keys, node);
@@ -169,7 +554,7 @@ void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys_per_loop) {
 
 void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *up_key) {
     REDISMODULE_NOT_USED(up_key);
-    int keys_per_loop = g_expire_algorithm.keys_per_passive_loop;
+    int keys_per_loop = g_expire_algorithm.effective_keys_per_passive_loop;
     long long when, now;
     int start_index = 0;
     m_zskiplistNode *ln = NULL;
@@ -205,7 +590,7 @@ void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *up_key) {
     }
 
     if (start_index) {
-        m_zslDeleteRangeByRank(g_expire_index[dbid], 1, start_index);
+        m_zslDeleteHead(g_expire_index[dbid], start_index);
     }
 
     if (listLength(keys) == 0) {
@@ -214,7 +599,12 @@ void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *up_key) {
     }
 
     /* 3. Delete expired field. */
-    keys_per_loop = g_expire_algorithm.keys_per_passive_loop;
+    if (g_expire_algorithm.index_thread) {
+        expireKeysWithIndexThread(ctx, dbid, keys, g_expire_algorithm.effective_keys_per_passive_loop, 0, &g_expire_algorithm.stat_passive_expired_field[dbid]);
+        m_listRelease(keys);
+        return;
+    }
+    keys_per_loop = g_expire_algorithm.effective_keys_per_passive_loop;
     m_listNode *node;
     while ((node = listFirst(keys)) != NULL) {
         key = listNodeValue(node);
@@ -223,13 +613,27 @@ void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *up_key) {
 
         Module_Assert(type != REDISMODULE_KEYTYPE_EMPTY && RedisModule_ModuleTypeGetType(real_key) == TairHashType);
         tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
+        /* The entry has been popped, the key is re-indexed below if it still has fields to expire. */
+        tair_hash_obj->global_expire_score = 0;
+        if (keyExpireIfNeeded(ctx, dbid, real_key, key, tair_hash_obj, 0)) {
+            m_listDelNode(keys, node);
+            continue;
+        }
 
         zsl_len = tair_hash_obj->expire_index->length;
-        Module_Assert(zsl_len > 0);
+        if (zsl_len == 0) {
+            /* A stale entry, all the fields with expire have been deleted or persisted. */
+            RedisModule_CloseKey(real_key);
+            m_listDelNode(keys, node);
+            continue;
+        }
 
         start_index = 0;
         ln = tair_hash_obj->expire_index->header->level[0].forward;
         while (ln && keys_per_loop) {
+            if (!bucketExpireIfNeeded(ctx, dbid, key, tair_hash_obj, ln, &keys_per_loop, &g_expire_algorithm.stat_passive_expired_field[dbid]) || !keys_per_loop) {
+                break;
+            }
             field = ln->member;
             if (fieldExpireIfNeeded(ctx, dbid, key, tair_hash_obj, field, 1)) {
                 g_expire_algorithm.stat_passive_expired_field[dbid]++;
@@ -242,14 +646,14 @@ void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *up_key) {
         }
 
         if (start_index) {
-            m_zslDeleteRangeByRank(tair_hash_obj->expire_index, 1, start_index);
-            if (!delEmptyTairHashIfNeeded(ctx, real_key, key, tair_hash_obj)) {
-                RedisModule_CloseKey(real_key);
-            }
+            m_zslDeleteHead(tair_hash_obj->expire_index, start_index);
+        }
+        if (!start_index || !delEmptyTairHashIfNeeded(ctx, real_key, key, tair_hash_obj)) {
+            RedisModule_CloseKey(real_key);
         }
 
         if (ln) {
-            m_zslInsert(g_expire_index[dbid], ln->score, takeAndRef(tair_hash_obj->key));
+            globalExpireIndexUpdate(dbid, tair_hash_obj, ln->score);
         }
 
         m_listDelNode(keys, node);
@@ -262,16 +666,10 @@ void deleteAndPropagate(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, t
     RedisModuleString *key_dup = RedisModule_CreateStringFromString(NULL, key);
     RedisModuleString *field_dup = RedisModule_CreateStringFromString(NULL, field);
     if (!is_timer) {
-        long long before_min_score = o->expire_index->header->level[0].forward->score;
-        m_zslDelete(o->expire_index, expire, field_dup, NULL);
-        if (o->expire_index->header->level[0].forward != NULL) {
-            long long after_min_score = o->expire_index->header->level[0].forward->score;
-            m_zslUpdateScore(g_expire_index[dbid], before_min_score, key, after_min_score);
-        } else {
-            m_zslDelete(g_expire_index[dbid], before_min_score, key, NULL);
-        }
+        fieldIndexChange(FIELD_INDEX_DELETE, o->expire_index, field, expire, 0);
     }
-    m_dictDelete(o->hash, field);
+    expireFieldRemoved(o, expire);
+    tairHashDeleteField(ctx, o, field);
     RedisModule_Replicate(ctx, "EXHDEL", "ss", key_dup, field_dup);
     notifyFieldSpaceEvent("expired", key_dup, field_dup, dbid);
     RedisModule_FreeString(NULL, key_dup);
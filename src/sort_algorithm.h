@@ -19,7 +19,12 @@
 void insert(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *obj, RedisModuleString *field, long long expire);
 void update(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *obj, RedisModuleString *field, long long cur_expire, long long new_expire);
 void delete(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *obj, RedisModuleString *field, long long expire);
+size_t rangeByExpire(tairHashObj *obj, long long min, long long max, long long *expires, RedisModuleString **fields, size_t limit);
+unsigned long countExpired(tairHashObj *obj, long long now);
+long long maxExpire(tairHashObj *obj, long long cur_expire);
 void deleteAndPropagate(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *obj, RedisModuleString *field, long long expire, int is_timer);
 void activeExpire(RedisModuleCtx *ctx, int dbid, uint64_t keys);
 void passiveExpire(RedisModuleCtx *ctx, int dbid, RedisModuleString *key_per_loop);
+void fieldIndexFree(m_zskiplist *zsl);
+long long fieldIndexMinExpire(tairHashObj *o);
 #endif
\ No newline at end of file
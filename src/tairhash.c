@@ -32,6 +32,9 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "btree_algorithm.h"
+#include "indexthread.h"
+#include "lazyfree.h"
 #include "scan_algorithm.h"
 #include "slab_algorithm.h"
 #include "sort_algorithm.h"
@@ -42,12 +45,13 @@ static int redis_major_ver = 0;
 static int redis_minor_ver = 0;
 static int redis_patch_ver = 0;
 
-#if defined(SORT_MODE) || defined(SLAB_MODE)
-m_zskiplist *g_expire_index[DB_NUM];
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
+m_zskiplist **g_expire_index;
 #endif
 
 RedisModuleTimerID g_expire_timer_id;
 ExpireAlgorithm g_expire_algorithm;
+static uint64_t g_obj_generation = 0;
 
 void _moduleAssert(const char *estr, const char *file, int line) {
     fprintf(stderr, "=== ASSERTION FAILED ===");
@@ -70,6 +74,25 @@ void tairHashValRelease(struct TairHashVal *o) {
     }
 }
 
+/* Release an entry unlinked from the hash, big values are released in the lazyfree thread. */
+static void freeUnlinkedField(RedisModuleCtx *ctx, tairHashObj *o, m_dictEntry *de) {
+    if (lazyfreeTairHashValIfNeeded(ctx, dictGetVal(de))) {
+        dictSetVal(o->hash, de, NULL);
+    }
+    m_dictFreeUnlinkedEntry(o->hash, de);
+}
+
+/* Delete `field` from the hash, return 1 if the field is found and deleted, otherwise 0. */
+int tairHashDeleteField(RedisModuleCtx *ctx, tairHashObj *o, RedisModuleString *field) {
+    m_dictEntry *de = m_dictUnlink(o->hash, field);
+    if (de == NULL) {
+        return 0;
+    }
+
+    freeUnlinkedField(ctx, o, de);
+    return 1;
+}
+
 RedisModuleString *takeAndRef(RedisModuleString *str) {
     RedisModule_RetainString(NULL, str);
     return str;
@@ -80,11 +103,16 @@ int isExpire(long long when) {
     return RedisModule_Milliseconds() > when;
 }
 
-int delEmptyTairHashIfNeeded(RedisModuleCtx *ctx, RedisModuleKey *key, RedisModuleString *raw_key, tairHashObj *obj) {
-    if (!obj || (RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_SLAVE) || (dictSize(obj->hash) != 0)) {
-        return 0;
-    }
+/* Before redis 6.2, using `RedisModule_Replicate` or `RedisModule_DeleteKey` in a timer callback
+ * generates nested MULTIs or loses the propagation, see bugfix:
+ * https://github.com/redis/redis/pull/8617
+ * https://github.com/redis/redis/pull/8097
+ * https://github.com/redis/redis/pull/7037 */
+int canPropagateInTimer(void) {
+    return redis_major_ver > 6 || (redis_major_ver == 6 && redis_minor_ver >= 2);
+}
 
+static int deleteTairHashKey(RedisModuleCtx *ctx, RedisModuleKey *key, RedisModuleString *raw_key) {
     if (key == NULL) {
         key = RedisModule_OpenKey(ctx, raw_key, REDISMODULE_WRITE);
         if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
@@ -93,11 +121,7 @@ int delEmptyTairHashIfNeeded(RedisModuleCtx *ctx, RedisModuleKey *key, RedisModu
         }
     }
 
-    if (redis_major_ver < 6 || (redis_major_ver == 6 && redis_minor_ver < 2)) {
-        /* See bugfix: https://github.com/redis/redis/pull/8617
-                       https://github.com/redis/redis/pull/8097
-                       https://github.com/redis/redis/pull/7037
-        */
+    if (!canPropagateInTimer()) {
         RedisModule_CloseKey(key);
         RedisModuleCtx *ctx2 = RedisModule_GetThreadSafeContext(NULL);
         RedisModule_SelectDb(ctx2, RedisModule_GetSelectedDb(ctx));
@@ -115,6 +139,77 @@ int delEmptyTairHashIfNeeded(RedisModuleCtx *ctx, RedisModuleKey *key, RedisModu
     return 1;
 }
 
+int delEmptyTairHashIfNeeded(RedisModuleCtx *ctx, RedisModuleKey *key, RedisModuleString *raw_key, tairHashObj *obj) {
+    if (!obj || (RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_SLAVE) || (dictSize(obj->hash) != 0)) {
+        return 0;
+    }
+    return deleteTairHashKey(ctx, key, raw_key);
+}
+
+/* If every field of the key has an expire and all of them have expired, drop the whole
+ * key at once instead of deleting (and replicating) its fields one by one. The field
+ * `expired` events are still published one by one on purpose, subscribers of the field
+ * space get the same events whichever way the fields expire. The key is released by
+ * redis, so `lazyfree-lazy-server-del` applies. `key` is closed if the key is deleted. */
+int keyExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleKey *key, RedisModuleString *raw_key, tairHashObj *obj, int is_active) {
+    if (!obj || obj->expire_fields == 0 || obj->expire_fields != dictSize(obj->hash)) {
+        return 0;
+    }
+
+    if (isReadOnlyStatus(ctx) || RedisModule_Milliseconds() < obj->max_expire) {
+        return 0;
+    }
+
+    if (is_active) {
+        g_expire_algorithm.stat_active_expired_field[dbid] += dictSize(obj->hash);
+    } else {
+        g_expire_algorithm.stat_passive_expired_field[dbid] += dictSize(obj->hash);
+    }
+    g_expire_algorithm.stat_whole_key_expired++;
+
+    /* `raw_key` may be `obj->key` itself, which is released together with the value
+     * (possibly in the lazyfree thread), so work on a private copy from now on. */
+    RedisModuleString *name = RedisModule_CreateStringFromString(NULL, raw_key);
+    m_dictIterator *di = m_dictGetIterator(obj->hash);
+    m_dictEntry *de;
+    while ((de = m_dictNext(di)) != NULL) {
+        notifyFieldSpaceEvent("expired", name, dictGetKey(de), dbid);
+    }
+    m_dictReleaseIterator(di);
+
+    RedisModule_CloseKey(key);
+    deleteTairHashKey(ctx, NULL, name);
+    RedisModule_FreeString(NULL, name);
+    return 1;
+}
+
+/* Keep `expire_fields` and `max_expire` in sync with the expire index, these are called
+ * by the insert/update/delete callbacks of each expire algorithm once the index has been
+ * changed. `max_expire` is lowered from the tail of the index when a field leaves it. */
+void expireFieldAdded(tairHashObj *obj, long long expire) {
+    obj->expire_fields++;
+    if (expire > obj->max_expire) {
+        obj->max_expire = expire;
+    }
+}
+
+void expireFieldUpdated(tairHashObj *obj, long long cur_expire, long long new_expire) {
+    if (new_expire >= obj->max_expire) {
+        obj->max_expire = new_expire;
+    } else {
+        obj->max_expire = g_expire_algorithm.maxExpire(obj, cur_expire);
+    }
+}
+
+void expireFieldRemoved(tairHashObj *obj, long long cur_expire) {
+    Module_Assert(obj->expire_fields > 0);
+    if (--obj->expire_fields == 0) {
+        obj->max_expire = 0;
+    } else {
+        obj->max_expire = g_expire_algorithm.maxExpire(obj, cur_expire);
+    }
+}
+
 void notifyFieldSpaceEvent(char *event, RedisModuleString *key, RedisModuleString *field, int dbid) {
     size_t key_len, field_len;
     const char *key_ptr = RedisModule_StringPtrLen(key, &key_len);
@@ -137,22 +232,6 @@ void notifyFieldSpaceEvent(char *event, RedisModuleString *key, RedisModuleStrin
     RedisModule_FreeString(NULL, message);
 }
 
-void tairhashScanCallback(void *privdata, const m_dictEntry *de) {
-    list *keys = (list *)privdata;
-    RedisModuleString *key, *val = NULL;
-
-    RedisModuleString *skey = dictGetKey(de);
-    TairHashVal *sval = dictGetVal(de);
-    key = skey;
-    if (sval) {
-        val = sval->value;
-    }
-    m_listAddNodeTail(keys, key);
-    if (val) {
-        m_listAddNodeTail(keys, val);
-    }
-}
-
 uint64_t dictModuleStrHash(const void *key) {
     size_t len;
     const char *buf = RedisModule_StringPtrLen(key, &len);
@@ -198,6 +277,10 @@ static void tairHashTypeReleaseObject(struct tairHashObj *o) {
     m_dictRelease(o->hash);
 #ifdef SLAB_MODE
     slab_free(o->expire_index);
+#elif defined(BTREE_MODE)
+    m_btreeFree(o->expire_index);
+#elif defined(SORT_MODE)
+    fieldIndexFree(o->expire_index);
 #else
     m_zslFree(o->expire_index);
 #endif
@@ -210,8 +293,11 @@ static void tairHashTypeReleaseObject(struct tairHashObj *o) {
 static struct tairHashObj *createTairHashTypeObject() {
     tairHashObj *o = RedisModule_Calloc(1, sizeof(*o));
     o->hash = m_dictCreate(&tairhashDictType, NULL);
+    o->generation = ++g_obj_generation;
 #ifdef SLAB_MODE
     o->expire_index = slab_create();
+#elif defined(BTREE_MODE)
+    o->expire_index = m_btreeCreate();
 #else
     o->expire_index = m_zslCreate();
 #endif
@@ -228,6 +314,32 @@ int isReadOnlyStatus(RedisModuleCtx *ctx) {
 }
 
 /* ========================== Common  func =============================*/
+/* Scale the expire quotas with the memory pressure, so that already expired fields are
+ * reclaimed faster before redis starts to evict live keys. The level grows by one for
+ * each third of the range between `memory_pressure_ratio` and maxmemory. */
+void updateMemoryPressure(void) {
+    int level = 0;
+    uint64_t ratio = g_expire_algorithm.memory_pressure_ratio;
+    if (ratio && RedisModule_GetUsedMemoryRatio) {
+        float used = RedisModule_GetUsedMemoryRatio();
+        float start = ratio / 100.0f;
+        if (used >= start) {
+            level = 1 + (int)((used - start) * TAIR_HASH_MEMORY_PRESSURE_MAX_LEVEL / (1.0f - start));
+            if (level > TAIR_HASH_MEMORY_PRESSURE_MAX_LEVEL) {
+                level = TAIR_HASH_MEMORY_PRESSURE_MAX_LEVEL;
+            }
+        }
+    }
+
+    g_expire_algorithm.memory_pressure_level = level;
+    g_expire_algorithm.effective_keys_per_active_loop = g_expire_algorithm.keys_per_active_loop << level;
+    g_expire_algorithm.effective_keys_per_passive_loop = g_expire_algorithm.keys_per_passive_loop << level;
+    g_expire_algorithm.effective_active_expire_period = g_expire_algorithm.active_expire_period >> level;
+    if (g_expire_algorithm.effective_active_expire_period == 0) {
+        g_expire_algorithm.effective_active_expire_period = 1;
+    }
+}
+
 void activeExpireTimerHandler(RedisModuleCtx *ctx, void *data) {
     REDISMODULE_NOT_USED(data);
     RedisModule_AutoMemory(ctx);
@@ -235,14 +347,22 @@ void activeExpireTimerHandler(RedisModuleCtx *ctx, void *data) {
     static unsigned int current_db = 0;
     int dbs_per_call = g_expire_algorithm.dbs_per_active_loop;
 
+    updateMemoryPressure();
     if (isReadOnlyStatus(ctx)) {
         goto restart;
     }
 
     long long start = RedisModule_Milliseconds();
 
-    for (int i = 0; i < dbs_per_call; ++i) {
-        current_db = current_db % DB_NUM;
+    /* Visit each db at most once per call, only dbs with expire work count towards `dbs_per_call`. */
+    for (int i = 0; i < g_expire_algorithm.db_num && dbs_per_call > 0; ++i) {
+        current_db = current_db % g_expire_algorithm.db_num;
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
+        if (g_expire_index[current_db]->length == 0) {
+            current_db++;
+            continue;
+        }
+#endif
         if (RedisModule_SelectDb(ctx, current_db) != REDISMODULE_OK) {
             current_db++;
             continue;
@@ -254,8 +374,9 @@ void activeExpireTimerHandler(RedisModuleCtx *ctx, void *data) {
         }
 
         /* Perform active expire algorithm. */
-        g_expire_algorithm.activeExpire(ctx, current_db, g_expire_algorithm.keys_per_active_loop);
+        g_expire_algorithm.activeExpire(ctx, current_db, g_expire_algorithm.effective_keys_per_active_loop);
         current_db++;
+        dbs_per_call--;
     }
 
     g_expire_algorithm.stat_last_active_expire_time_msec = RedisModule_Milliseconds() - start;
@@ -271,15 +392,14 @@ void activeExpireTimerHandler(RedisModuleCtx *ctx, void *data) {
 
 restart:
     if (g_expire_algorithm.enable_active_expire) {
-        g_expire_timer_id = RedisModule_CreateTimer(ctx, g_expire_algorithm.active_expire_period, activeExpireTimerHandler, NULL);
+        g_expire_timer_id = RedisModule_CreateTimer(ctx, g_expire_algorithm.effective_active_expire_period, activeExpireTimerHandler, NULL);
     }
 }
 
-int fieldExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, int is_timer) {
-    TairHashVal *tair_hash_val = m_dictFetchValue(o->hash, field);
-    if (tair_hash_val == NULL) {
-        return 0;
-    }
+/* Expire the field of `de` if needed, returns 1 if the field has expired. On a readonly
+ * replica the field is only reported as expired, the master will propagate its deletion. */
+int fieldEntryExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, m_dictEntry *de, int is_timer) {
+    TairHashVal *tair_hash_val = dictGetVal(de);
 
     long long when = tair_hash_val->expire;
     if (when == 0) {
@@ -295,11 +415,107 @@ int fieldExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, t
         return 0;
     }
 
-    g_expire_algorithm.deleteAndPropagate(ctx, dbid, key, o, field, when, is_timer);
+    /* The expire index is keyed by the field object owned by the hash. */
+    g_expire_algorithm.deleteAndPropagate(ctx, dbid, key, o, dictGetKey(de), when, is_timer);
     return 1;
 }
 
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+int fieldExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, int is_timer) {
+    m_dictEntry *de = m_dictFind(o->hash, field);
+    if (de == NULL) {
+        return 0;
+    }
+    return fieldEntryExpireIfNeeded(ctx, dbid, key, o, de, is_timer);
+}
+
+/* Look up `field` for a command, an expired field is expired on the way and NULL is
+ * returned as if it did not exist, so the hash is only probed once per field. */
+m_dictEntry *lookupField(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field) {
+    m_dictEntry *de = m_dictFind(o->hash, field);
+    if (de && fieldEntryExpireIfNeeded(ctx, dbid, key, o, de, 0)) {
+        return NULL;
+    }
+    return de;
+}
+
+/* Like lookupField(), but also returns the position to add `field` at if it does not
+ * exist, see m_dictInsertAtPosition(). Only an expired field costs a second probe. */
+static m_dictEntry *lookupFieldForWrite(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, void **position) {
+    m_dictEntry *de;
+    *position = m_dictFindPositionForInsert(o->hash, field, &de);
+    if (de && fieldEntryExpireIfNeeded(ctx, dbid, key, o, de, 0)) {
+        *position = m_dictFindPositionForInsert(o->hash, field, &de);
+    }
+    return de;
+}
+
+/* lookupField() for `n` fields at once, see m_dictFindBatch(). A field may be asked
+ * for more than once, so an expired entry is cleared from every slot holding it. */
+static void lookupFields(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString **fields, m_dictEntry **entries, size_t n) {
+    m_dictFindBatch(o->hash, (void **)fields, entries, n);
+    for (size_t i = 0; i < n; i++) {
+        m_dictEntry *de = entries[i];
+        if (de && fieldEntryExpireIfNeeded(ctx, dbid, key, o, de, 0)) {
+            for (size_t j = i; j < n; j++) {
+                if (entries[j] == de) {
+                    entries[j] = NULL;
+                }
+            }
+        }
+    }
+}
+
+/* Unlink `field` for a command that removes it, so the hash is only probed once. An
+ * expired field is expired on the way and NULL is returned, a returned entry is
+ * released by the caller with freeUnlinkedField(). */
+static m_dictEntry *unlinkField(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field) {
+    m_dictEntry *de = m_dictUnlink(o->hash, field);
+    if (de == NULL) {
+        return NULL;
+    }
+
+    TairHashVal *tair_hash_val = dictGetVal(de);
+    if (fieldEntryExpireIfNeeded(ctx, dbid, key, o, de, 0)) {
+        /* A writable replica only reports the field as expired, it is gone anyway. */
+        if (isReadOnlyStatus(ctx)) {
+            g_expire_algorithm.delete(ctx, dbid, key, o, dictGetKey(de), tair_hash_val->expire);
+        }
+        freeUnlinkedField(ctx, o, de);
+        return NULL;
+    }
+    return de;
+}
+
+/* Add a new field at the position found by lookupFieldForWrite(). */
+static void addFieldAtPosition(tairHashObj *o, RedisModuleString *field, TairHashVal *val, void *position) {
+    m_dictEntry *de = m_dictInsertAtPosition(o->hash, takeAndRef(field), position);
+    dictSetVal(o->hash, de, val);
+}
+
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
+/* The global expire index holds at most one entry per key, its score is a lower bound
+ * of the earliest field expire of the key. We only move it when the minimum becomes
+ * earlier, so most TTL updates and all field deletions never touch the global index.
+ * Stale entries are revalidated by the expire cycles: the entry is popped and the key
+ * is re-indexed with its real minimum if there are fields left. Members borrow `o->key`
+ * and are compared by pointer, so no string compare is needed to locate a key. */
+void globalExpireIndexUpdate(int dbid, tairHashObj *o, long long min_expire) {
+    if (o->global_expire_score == 0) {
+        m_zslInsert(g_expire_index[dbid], min_expire, o->key);
+        o->global_expire_score = min_expire;
+    } else if (min_expire < o->global_expire_score) {
+        m_zslUpdateScore(g_expire_index[dbid], o->global_expire_score, o->key, min_expire);
+        o->global_expire_score = min_expire;
+    }
+}
+
+void globalExpireIndexDelete(int dbid, tairHashObj *o) {
+    if (o->global_expire_score) {
+        m_zslDelete(g_expire_index[dbid], o->global_expire_score, o->key);
+        o->global_expire_score = 0;
+    }
+}
+
 void swapDbCallback(RedisModuleCtx *ctx, RedisModuleEvent e, uint64_t sub, void *data) {
     REDISMODULE_NOT_USED(e);
     REDISMODULE_NOT_USED(sub);
@@ -337,7 +553,7 @@ void flushDbCallback(RedisModuleCtx *ctx, RedisModuleEvent e, uint64_t sub, void
             m_zslFree(g_expire_index[fi->dbnum]);
             g_expire_index[fi->dbnum] = m_zslCreate();
         } else {
-            for (int i = 0; i < DB_NUM; i++) {
+            for (int i = 0; i < g_expire_algorithm.db_num; i++) {
                 m_zslFree(g_expire_index[i]);
                 g_expire_index[i] = m_zslCreate();
             }
@@ -373,18 +589,16 @@ static int keySpaceNotification(RedisModuleCtx *ctx, int type, const char *event
     }
 
     if (cmd_flag != CMD_NONE) {
-        RedisModuleString *local_from_key = NULL, *local_to_key = NULL;
+        RedisModuleString *local_to_key = NULL;
         int local_from_dbid, local_to_dbid;
         /* We assign values in advance so that `move` and `rename` can be processed uniformly. */
         if (cmd_flag == CMD_RENAME) {
-            local_from_key = from_key;
             local_to_key = to_key;
             /* `rename` does not change the dbid of the key. */
             local_from_dbid = dbid;
             local_to_dbid = dbid;
         } else {
             /* `move` does not change the name of the key. */
-            local_from_key = key;
             local_to_key = key;
             local_from_dbid = from_dbid;
             local_to_dbid = to_dbid;
@@ -397,17 +611,20 @@ static int keySpaceNotification(RedisModuleCtx *ctx, int type, const char *event
         tairHashObj *tair_hash_obj = RedisModule_ModuleTypeGetValue(real_key);
 
         /* If there are no expire fields, we don’t have any indexes to adjust, just return ASAP. */
-        if (tair_hash_obj->expire_index->length == 0) {
+        if (tair_hash_obj->expire_fields == 0) {
             return REDISMODULE_OK;
         }
 #ifdef SLAB_MODE
         long long previous_index = tair_hash_obj->expire_index->header->level[0].forward->expire_min;
+#elif defined(BTREE_MODE)
+        long long previous_index = tair_hash_obj->expire_index->head->expires[0];
 #else
-        long long previous_index = tair_hash_obj->expire_index->header->level[0].forward->score;
+        long long previous_index = fieldIndexMinExpire(tair_hash_obj);
 #endif
 
-        /* Delete the previous index */
-        m_zslDelete(g_expire_index[local_from_dbid], previous_index, local_from_key, NULL);
+        /* Delete the previous index (usually already done by unlink2 of the source key), members
+         * are identified by `tair_hash_obj->key`, so it must be done before renaming. */
+        globalExpireIndexDelete(local_from_dbid, tair_hash_obj);
         if (tair_hash_obj->key) {
             /* Change key name. */
             RedisModule_FreeString(NULL, tair_hash_obj->key);
@@ -415,7 +632,7 @@ static int keySpaceNotification(RedisModuleCtx *ctx, int type, const char *event
         }
 
         /* Re-insert to dst index. */
-        m_zslInsert(g_expire_index[local_to_dbid], previous_index, takeAndRef(tair_hash_obj->key));
+        globalExpireIndexUpdate(local_to_dbid, tair_hash_obj, previous_index);
 
         /* Release sources. */
         if (cmd_flag == CMD_RENAME) {
@@ -447,10 +664,27 @@ void infoFunc(RedisModuleInfoCtx *ctx, int for_crash_report) {
     RedisModule_InfoAddFieldLongLong(ctx, "active_expire_max_time_msec", g_expire_algorithm.stat_max_active_expire_time_msec);
     RedisModule_InfoAddFieldLongLong(ctx, "active_expire_avg_time_msec", g_expire_algorithm.stat_avg_active_expire_time_msec);
     RedisModule_InfoAddFieldLongLong(ctx, "passive_expire_keys_per_loop", g_expire_algorithm.keys_per_passive_loop);
+    RedisModule_InfoAddFieldLongLong(ctx, "whole_key_expired_keys", g_expire_algorithm.stat_whole_key_expired);
+    RedisModule_InfoAddFieldLongLong(ctx, "expire_granularity", g_expire_algorithm.expire_granularity);
+    RedisModule_InfoAddFieldLongLong(ctx, "memory_pressure_ratio", g_expire_algorithm.memory_pressure_ratio);
+    RedisModule_InfoAddFieldLongLong(ctx, "memory_pressure_level", g_expire_algorithm.memory_pressure_level);
+    RedisModule_InfoAddFieldLongLong(ctx, "effective_active_expire_period", g_expire_algorithm.effective_active_expire_period);
+    RedisModule_InfoAddFieldLongLong(ctx, "effective_active_expire_keys_per_loop", g_expire_algorithm.effective_keys_per_active_loop);
+    RedisModule_InfoAddFieldLongLong(ctx, "effective_passive_expire_keys_per_loop", g_expire_algorithm.effective_keys_per_passive_loop);
+    RedisModule_InfoAddFieldLongLong(ctx, "lazyfree_threshold", g_expire_algorithm.lazyfree_threshold);
+    RedisModule_InfoAddFieldLongLong(ctx, "lazyfree_max_pending", g_expire_algorithm.lazyfree_max_pending);
+    RedisModule_InfoAddFieldLongLong(ctx, "lazyfree_pending_objects", lazyfreeGetPendingObjects());
+    RedisModule_InfoAddFieldLongLong(ctx, "lazyfree_freed_objects", lazyfreeGetFreedObjects());
+    RedisModule_InfoAddFieldLongLong(ctx, "lazyfree_sync_freed_objects", lazyfreeGetSyncFreedObjects());
+    RedisModule_InfoAddFieldLongLong(ctx, "chunked_read_threshold", g_expire_algorithm.chunked_read_threshold);
+    RedisModule_InfoAddFieldLongLong(ctx, "chunked_read_fields_per_loop", g_expire_algorithm.chunked_read_fields_per_loop);
+    RedisModule_InfoAddFieldLongLong(ctx, "index_thread", g_expire_algorithm.index_thread);
+    RedisModule_InfoAddFieldLongLong(ctx, "index_thread_pending_jobs", indexThreadGetPendingJobs());
+    RedisModule_InfoAddFieldLongLong(ctx, "index_thread_processed_jobs", indexThreadGetProcessedJobs());
 
     RedisModule_InfoAddSection(ctx, "ActiveExpiredFields");
-    char buf[10];
-    for (int i = 0; i < DB_NUM; ++i) {
+    char buf[16];
+    for (int i = 0; i < g_expire_algorithm.db_num; ++i) {
         if (g_expire_index[i]->length == 0 && g_expire_algorithm.stat_active_expired_field[i] == 0) {
             continue;
         }
@@ -459,7 +693,7 @@ void infoFunc(RedisModuleInfoCtx *ctx, int for_crash_report) {
     }
 
     RedisModule_InfoAddSection(ctx, "PassiveExpiredFields");
-    for (int i = 0; i < DB_NUM; ++i) {
+    for (int i = 0; i < g_expire_algorithm.db_num; ++i) {
         if (g_expire_index[i]->length == 0 && g_expire_algorithm.stat_passive_expired_field[i] == 0) {
             continue;
         }
@@ -500,15 +734,12 @@ static int mstrmatchlen(RedisModuleString *pattern, RedisModuleString *str, int
 }
 
 int tairHashExpireGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, long long basetime, int unit) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc < 4 || argc > 7) {
         return RedisModule_WrongArity(ctx);
     }
 
     long long milliseconds;
     long long version = 0;
-    int field_expired = 0;
     int nokey;
 
     if (RedisModule_StringToLongLong(argv[3], &milliseconds) != REDISMODULE_OK) {
@@ -560,12 +791,14 @@ int tairHashExpireGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     tairHashObj *tair_hash_obj = NULL;
     if (type == REDISMODULE_KEYTYPE_EMPTY) {
         RedisModule_ReplyWithLongLong(ctx, 0);
+        RedisModule_CloseKey(key);
         return REDISMODULE_OK;
     } else {
         tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
@@ -574,13 +807,9 @@ int tairHashExpireGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
     RedisModuleString *skey = argv[2], *pkey = argv[1];
 
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, pkey, tair_hash_obj, skey, 0)) {
-        field_expired = 1;
-    }
-
     TairHashVal *tair_hash_val = NULL;
-    m_dictEntry *de = m_dictFind(tair_hash_obj->hash, skey);
-    if (field_expired || de == NULL) {
+    m_dictEntry *de = lookupField(ctx, dbid, pkey, tair_hash_obj, skey);
+    if (de == NULL) {
         nokey = 1;
         RedisModule_ReplyWithLongLong(ctx, 0);
     } else {
@@ -590,11 +819,13 @@ int tairHashExpireGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
         if (ex_flags & TAIR_HASH_SET_WITH_VER) {
             if (version != 0 && version != tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         } else if (ex_flags & TAIR_HASH_SET_WITH_GT_VER) {
             if (version <= tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         }
@@ -626,21 +857,17 @@ int tairHashExpireGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
             tair_hash_val->version += 1;
         }
 
-        size_t vlen = 0, VSIZE_MAX = 5;
-        RedisModuleString **v = RedisModule_Alloc(sizeof(RedisModuleString *) * VSIZE_MAX);
-        v[vlen++] = RedisModule_CreateStringFromString(ctx, argv[1]);
-        v[vlen++] = RedisModule_CreateStringFromString(ctx, argv[2]);
-        v[vlen++] = RedisModule_CreateStringFromLongLong(ctx, tair_hash_val->expire);
+        /* The replication arguments reuse argv, only the absolute expire is formatted. */
         if (version_p) {
-            v[vlen++] = RedisModule_CreateString(ctx, "ABS", 3);
-            v[vlen++] = RedisModule_CreateStringFromLongLong(ctx, tair_hash_val->version);
+            RedisModule_Replicate(ctx, "EXHPEXPIREAT", "sslcl", argv[1], argv[2], tair_hash_val->expire, "ABS", tair_hash_val->version);
+        } else {
+            RedisModule_Replicate(ctx, "EXHPEXPIREAT", "ssl", argv[1], argv[2], tair_hash_val->expire);
         }
-
-        RedisModule_Replicate(ctx, "EXHPEXPIREAT", "v", v, vlen);
-        RedisModule_Free(v);
     }
 
-    delEmptyTairHashIfNeeded(ctx, key, pkey, tair_hash_obj);
+    if (!delEmptyTairHashIfNeeded(ctx, key, pkey, tair_hash_obj)) {
+        RedisModule_CloseKey(key);
+    }
     return REDISMODULE_OK;
 }
 
@@ -651,8 +878,6 @@ int tairHashTTLGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
         return RedisModule_WrongArity(ctx);
     }
 
-    int field_expired = 0;
-
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
@@ -676,12 +901,9 @@ int tairHashTTLGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
     RedisModuleString *pkey = argv[1], *skey = argv[2];
 
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, pkey, tair_hash_obj, skey, 0)) {
-        field_expired = 1;
-    }
-
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, skey);
-    if (field_expired || tair_hash_val == NULL) {
+    m_dictEntry *de = lookupField(ctx, dbid, pkey, tair_hash_obj, skey);
+    TairHashVal *tair_hash_val = de ? dictGetVal(de) : NULL;
+    if (tair_hash_val == NULL) {
         RedisModule_ReplyWithLongLong(ctx, -3);
     } else {
         if (tair_hash_val->expire == 0) {
@@ -718,10 +940,8 @@ int mstring2ld(RedisModuleString *val, long double *r_val) {
 
 /* ========================= "tairhash" type commands ======================= */
 
-/* EXHSET <key> <field> <value> [EX time] [EXAT time] [PX time] [PXAT time] [NX|XX] [VER version | ABS version] [KEEPTTL] */
+/* EXHSET <key> <field> <value> [EX time] [EXAT time] [PX time] [PXAT time] [NX|XX] [VER version | ABS version] [KEEPTTL] [GET] */
 int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc < 4) {
         return RedisModule_WrongArity(ctx);
     }
@@ -737,6 +957,7 @@ int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -778,29 +999,36 @@ int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
             j++;
         } else if (!mstrcasecmp(argv[j], "keepttl") && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_PX)) {
             ex_flags |= TAIR_HASH_SET_KEEPTTL;
+        } else if (!mstrcasecmp(argv[j], "get")) {
+            ex_flags |= TAIR_HASH_SET_GET;
         } else {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
     }
 
     if ((NULL != expire_p) && (RedisModule_StringToLongLong(expire_p, &expire) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (expire_p && expire < 0) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if ((NULL != version_p) && (RedisModule_StringToLongLong(version_p, &version) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (version < 0 || ((ex_flags & (TAIR_HASH_SET_WITH_ABS_VER | TAIR_HASH_SET_WITH_GT_VER)) && version == 0)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -809,7 +1037,12 @@ int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     tairHashObj *tair_hash_obj = NULL;
     if (type == REDISMODULE_KEYTYPE_EMPTY) {
         if (ex_flags & TAIR_HASH_SET_XX) {
-            RedisModule_ReplyWithLongLong(ctx, -1);
+            if (ex_flags & TAIR_HASH_SET_GET) {
+                RedisModule_ReplyWithNull(ctx);
+            } else {
+                RedisModule_ReplyWithLongLong(ctx, -1);
+            }
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
         tair_hash_obj = createTairHashTypeObject();
@@ -820,11 +1053,17 @@ int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     }
 
     int dbid = RedisModule_GetSelectedDb(ctx);
-    fieldExpireIfNeeded(ctx, dbid, pkey, tair_hash_obj, skey, 0);
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, skey);
-    if (tair_hash_val == NULL) {
+    TairHashVal *tair_hash_val = NULL;
+    void *position;
+    m_dictEntry *de = lookupFieldForWrite(ctx, dbid, pkey, tair_hash_obj, skey, &position);
+    if (de == NULL) {
         if (ex_flags & TAIR_HASH_SET_XX) {
-            RedisModule_ReplyWithLongLong(ctx, -1);
+            if (ex_flags & TAIR_HASH_SET_GET) {
+                RedisModule_ReplyWithNull(ctx);
+            } else {
+                RedisModule_ReplyWithLongLong(ctx, -1);
+            }
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
         nokey = 1;
@@ -834,8 +1073,15 @@ int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
         tair_hash_val->value = NULL;
     } else {
         nokey = 0;
+        tair_hash_val = dictGetVal(de);
+        skey = dictGetKey(de);
         if (ex_flags & TAIR_HASH_SET_NX) {
-            RedisModule_ReplyWithLongLong(ctx, -1);
+            if (ex_flags & TAIR_HASH_SET_GET) {
+                RedisModule_ReplyWithString(ctx, tair_hash_val->value);
+            } else {
+                RedisModule_ReplyWithLongLong(ctx, -1);
+            }
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
@@ -843,11 +1089,13 @@ int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
         if (ex_flags & TAIR_HASH_SET_WITH_VER) {
             if (version != 0 && version != tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         } else if (ex_flags & TAIR_HASH_SET_WITH_GT_VER) {
             if (version <= tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         }
@@ -886,40 +1134,41 @@ int TairHashTypeHset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
         tair_hash_val->expire = milliseconds;
     }
 
-    if (tair_hash_val->value) {
-        RedisModule_FreeString(NULL, tair_hash_val->value);
-    }
-
+    /* With GET the old value is the reply, it is released only after being replied. */
+    RedisModuleString *old_value = tair_hash_val->value;
     tair_hash_val->value = takeAndRef(argv[3]);
     if (nokey) {
-        m_dictAdd(tair_hash_obj->hash, takeAndRef(skey), tair_hash_val);
-        RedisModule_ReplyWithLongLong(ctx, 1);
+        addFieldAtPosition(tair_hash_obj, skey, tair_hash_val, position);
+    }
+    if (!(ex_flags & TAIR_HASH_SET_GET)) {
+        RedisModule_ReplyWithLongLong(ctx, nokey);
+    } else if (old_value) {
+        RedisModule_ReplyWithString(ctx, old_value);
     } else {
-        RedisModule_ReplyWithLongLong(ctx, 0);
+        RedisModule_ReplyWithNull(ctx);
     }
-
-    size_t vlen = 0, VSIZE_MAX = 7;
-    RedisModuleString **v = RedisModule_Alloc(sizeof(RedisModuleString *) * VSIZE_MAX);
-    v[vlen++] = RedisModule_CreateStringFromString(ctx, argv[1]);
-    v[vlen++] = RedisModule_CreateStringFromString(ctx, argv[2]);
-    v[vlen++] = RedisModule_CreateStringFromString(ctx, tair_hash_val->value);
-    if (version_p) {
-        v[vlen++] = RedisModule_CreateString(ctx, "ABS", 3);
-        v[vlen++] = RedisModule_CreateStringFromLongLong(ctx, tair_hash_val->version);
+    if (old_value) {
+        RedisModule_FreeString(NULL, old_value);
     }
-    if (expire_p) {
-        v[vlen++] = RedisModule_CreateString(ctx, "PXAT", 4);
-        v[vlen++] = RedisModule_CreateStringFromLongLong(ctx, tair_hash_val->expire);
+
+    /* Without a version or an expire to make absolute the command is replicated as is,
+     * NX/XX and KEEPTTL give the same result on the replica. Otherwise argv is reused
+     * and only the numbers are formatted, KEEPTTL becomes the PXAT it kept. */
+    if (!version_p && !expire_p) {
+        RedisModule_ReplicateVerbatim(ctx);
+    } else if (version_p && tair_hash_val->expire) {
+        RedisModule_Replicate(ctx, "EXHSET", "sssclcl", argv[1], argv[2], argv[3], "ABS", tair_hash_val->version, "PXAT", tair_hash_val->expire);
+    } else if (version_p) {
+        RedisModule_Replicate(ctx, "EXHSET", "ssscl", argv[1], argv[2], argv[3], "ABS", tair_hash_val->version);
+    } else {
+        RedisModule_Replicate(ctx, "EXHSET", "ssscl", argv[1], argv[2], argv[3], "PXAT", tair_hash_val->expire);
     }
-    RedisModule_Replicate(ctx, "EXHSET", "v", v, vlen);
-    RedisModule_Free(v);
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
 /* EXHSETNX <key> <field> <value> */
 int TairHashTypeHsetNx_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc != 4) {
         return RedisModule_WrongArity(ctx);
     }
@@ -930,6 +1179,7 @@ int TairHashTypeHsetNx_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **arg
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -944,38 +1194,37 @@ int TairHashTypeHsetNx_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **arg
         tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
     }
 
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, skey);
-    if (tair_hash_val == NULL) {
-        tair_hash_val = createTairHashVal();
-        tair_hash_val->expire = 0;
-    } else {
+    void *position;
+    if (lookupFieldForWrite(ctx, RedisModule_GetSelectedDb(ctx), pkey, tair_hash_obj, skey, &position) != NULL) {
         RedisModule_ReplyWithLongLong(ctx, 0);
+        RedisModule_CloseKey(key);
         return REDISMODULE_OK;
     }
 
+    TairHashVal *tair_hash_val = createTairHashVal();
+    tair_hash_val->expire = 0;
     tair_hash_val->value = takeAndRef(svalue);
-    m_dictAdd(tair_hash_obj->hash, takeAndRef(skey), tair_hash_val);
+    addFieldAtPosition(tair_hash_obj, skey, tair_hash_val, position);
 
     RedisModule_ReplicateVerbatim(ctx);
     RedisModule_ReplyWithLongLong(ctx, 1);
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
 /* EXHMSET key field value [field value …] */
 int TairHashTypeHmset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if ((argc % 2) == 1) {
         return RedisModule_WrongArity(ctx);
     }
 
     g_expire_algorithm.passiveExpire(ctx, RedisModule_GetSelectedDb(ctx), argv[1]);
 
-    int nokey;
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -990,33 +1239,33 @@ int TairHashTypeHmset_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
 
     int dbid = RedisModule_GetSelectedDb(ctx);
     for (int i = 2; i < argc; i += 2) {
-        fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[i], 0);
-        TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[i]);
-        if (tair_hash_val == NULL) {
-            nokey = 1;
+        void *position;
+        m_dictEntry *de = lookupFieldForWrite(ctx, dbid, argv[1], tair_hash_obj, argv[i], &position);
+        TairHashVal *tair_hash_val;
+        if (de == NULL) {
             tair_hash_val = createTairHashVal();
             tair_hash_val->expire = 0;
         } else {
+            tair_hash_val = dictGetVal(de);
             if (tair_hash_val->value) {
                 RedisModule_FreeString(NULL, tair_hash_val->value);
             }
         }
         tair_hash_val->value = takeAndRef(argv[i + 1]);
         tair_hash_val->version++;
-        if (nokey) {
-            m_dictAdd(tair_hash_obj->hash, takeAndRef(argv[i]), tair_hash_val);
+        if (de == NULL) {
+            addFieldAtPosition(tair_hash_obj, argv[i], tair_hash_val, position);
         }
     }
 
     RedisModule_ReplicateVerbatim(ctx);
     RedisModule_ReplyWithSimpleString(ctx, "OK");
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
 /* EXHMSETWITHOPTS tairHashkey field1 val1 ver1 expire1 [field2 val2 ver2 expire2 ...] */
 int TairHashTypeHmsetWithOpts_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (((argc - 2) % 4) != 0) {
         return RedisModule_WrongArity(ctx);
     }
@@ -1027,6 +1276,7 @@ int TairHashTypeHmsetWithOpts_RedisCommand(RedisModuleCtx *ctx, RedisModuleStrin
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1047,40 +1297,44 @@ int TairHashTypeHmsetWithOpts_RedisCommand(RedisModuleCtx *ctx, RedisModuleStrin
     for (int i = 2; i < argc; i += 4) {
         if (RedisModule_StringToLongLong(argv[i + 3], &when) != REDISMODULE_OK) {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
         if (RedisModule_StringToLongLong(argv[i + 2], &ver) != REDISMODULE_OK) {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
         if (ver < 0 || when < 0) {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
-        fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[i], 0);
-        TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[i]);
-        if (tair_hash_val == NULL || ver == 0 || tair_hash_val->version == ver) {
+        m_dictEntry *de = lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[i]);
+        if (de == NULL || ver == 0 || ((TairHashVal *)dictGetVal(de))->version == ver) {
             continue;
         } else {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
     }
 
-    size_t vlen = 0;
-    RedisModuleString **v = RedisModule_Alloc(sizeof(RedisModuleString *) * 7);
-
     for (int i = 2; i < argc; i += 4) {
         if (RedisModule_StringToLongLong(argv[i + 3], &when) != REDISMODULE_OK) {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
-        TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[i]);
-        if (tair_hash_val == NULL) {
+        RedisModuleString *skey = argv[i];
+        TairHashVal *tair_hash_val = NULL;
+        void *position;
+        m_dictEntry *de = lookupFieldForWrite(ctx, dbid, argv[1], tair_hash_obj, skey, &position);
+        if (de == NULL) {
             tair_hash_val = createTairHashVal();
             tair_hash_val->expire = 0;
             tair_hash_val->version = 0;
@@ -1088,6 +1342,8 @@ int TairHashTypeHmsetWithOpts_RedisCommand(RedisModuleCtx *ctx, RedisModuleStrin
             nokey = 1;
         } else {
             nokey = 0;
+            tair_hash_val = dictGetVal(de);
+            skey = dictGetKey(de);
         }
 
         if (tair_hash_val->value) {
@@ -1097,114 +1353,347 @@ int TairHashTypeHmsetWithOpts_RedisCommand(RedisModuleCtx *ctx, RedisModuleStrin
         tair_hash_val->value = takeAndRef(argv[i + 1]);
         tair_hash_val->version++;
 
-        int dbid = RedisModule_GetSelectedDb(ctx);
         when = RedisModule_Milliseconds() + when * 1000;
         if (nokey || tair_hash_val->expire == 0) {
-            g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, argv[i], when);
+            g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, skey, when);
         } else {
-            g_expire_algorithm.update(ctx, dbid, argv[1], tair_hash_obj, argv[i], tair_hash_val->expire, when);
+            g_expire_algorithm.update(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire, when);
         }
         tair_hash_val->expire = when;
 
         if (nokey) {
-            m_dictAdd(tair_hash_obj->hash, takeAndRef(argv[i]), tair_hash_val);
+            addFieldAtPosition(tair_hash_obj, skey, tair_hash_val, position);
         }
 
-        v[vlen++] = RedisModule_CreateStringFromString(ctx, argv[1]);
-        v[vlen++] = RedisModule_CreateStringFromString(ctx, argv[i]);
-        v[vlen++] = RedisModule_CreateStringFromString(ctx, argv[i + 1]);
-        v[vlen++] = RedisModule_CreateString(ctx, "ABS", 3);
-        v[vlen++] = RedisModule_CreateStringFromLongLong(ctx, tair_hash_val->version);
-        v[vlen++] = RedisModule_CreateString(ctx, "PXAT", 4);
-        v[vlen++] = RedisModule_CreateStringFromLongLong(ctx, tair_hash_val->expire);
-        RedisModule_Replicate(ctx, "EXHSET", "v", v, vlen);
-        vlen = 0;
+        RedisModule_Replicate(ctx, "EXHSET", "sssclcl", argv[1], argv[i], argv[i + 1], "ABS", tair_hash_val->version, "PXAT", tair_hash_val->expire);
     }
 
-    RedisModule_Free(v);
     RedisModule_ReplyWithSimpleString(ctx, "OK");
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
-/*  EXHPEXPIREAT <key> <field> <milliseconds-timestamp> [ VER version | ABS version | GT version ]*/
-int TairHashTypeHpexpireAt_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    return tairHashExpireGenericFunc(ctx, argv, argc, 0, UNIT_MILLISECONDS);
-}
-
-/*  EXHPEXPIRE <key> <field> <milliseconds> [ VER version | ABS version | GT version ]*/
-int TairHashTypeHpexpire_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    return tairHashExpireGenericFunc(ctx, argv, argc, RedisModule_Milliseconds(), UNIT_MILLISECONDS);
-}
-
-/*  EXHEXPIREAT <key> <field> <timestamp> [ VER version | ABS version | GT version ] */
-int TairHashTypeHexpireAt_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    return tairHashExpireGenericFunc(ctx, argv, argc, 0, UNIT_SECONDS);
-}
-
-/*  EXHEXPIRE <key> <field> <seconds> [ VER version | ABS version | GT version ] */
-int TairHashTypeHexpire_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    return tairHashExpireGenericFunc(ctx, argv, argc, RedisModule_Milliseconds(), UNIT_SECONDS);
-}
-
-/*  EXHPTTL <key> <field> */
-int TairHashTypeHpttl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    return tairHashTTLGenericFunc(ctx, argv, argc, UNIT_MILLISECONDS);
-}
-
-/*  EXHTTL <key> <field> */
-int TairHashTypeHttl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    return tairHashTTLGenericFunc(ctx, argv, argc, UNIT_SECONDS);
-}
-
-/* EXHPERSIST <key> <field> */
-int TairHashTypeHpersist_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
-    if (argc != 3) {
+/* EXHMSETEX <key> [NX|XX] [EX time|EXAT time|PX time|PXAT time|KEEPTTL] [VER version|ABS version|GT version] FIELDS <numfields> <field> <value> [<field> <value> ...] */
+int TairHashTypeHmsetEx_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc < 6) {
         return RedisModule_WrongArity(ctx);
     }
 
-    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
-    int type = RedisModule_KeyType(key);
-    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
-        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
-        return REDISMODULE_ERR;
-    }
-
-    tairHashObj *tair_hash_obj = NULL;
-    if (type == REDISMODULE_KEYTYPE_EMPTY) {
-        RedisModule_ReplyWithLongLong(ctx, 0);
-        return REDISMODULE_OK;
-    } else {
-        tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
-    }
-
-    if (tair_hash_obj == NULL) {
-        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INTERNAL_ERR);
-        return REDISMODULE_ERR;
-    }
-
-    int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0)) {
-        RedisModule_ReplyWithLongLong(ctx, 0);
-        return REDISMODULE_OK;
-    }
-
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[2]);
-    if (tair_hash_val == NULL) {
-        RedisModule_ReplyWithLongLong(ctx, 0);
-        return REDISMODULE_OK;
-    }
+    long long milliseconds = 0, expire = 0, numfields = 0, version = 0;
+    RedisModuleString *expire_p = NULL, *version_p = NULL;
+    int ex_flags = TAIR_HASH_SET_NO_FLAGS;
+    int j;
 
-    if (!tair_hash_val->expire) {
-        RedisModule_ReplyWithLongLong(ctx, 0);
-    } else {
-        int dbid = RedisModule_GetSelectedDb(ctx);
-        g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, argv[2], tair_hash_val->expire);
-        tair_hash_val->expire = 0;
-        RedisModule_ReplyWithLongLong(ctx, 1);
+    for (j = 2; j < argc; j++) {
+        RedisModuleString *next = (j == argc - 1) ? NULL : argv[j + 1];
+        if (!mstrcasecmp(argv[j], "fields") && next) {
+            break;
+        } else if (!mstrcasecmp(argv[j], "nx") && !(ex_flags & TAIR_HASH_SET_XX)) {
+            ex_flags |= TAIR_HASH_SET_NX;
+        } else if (!mstrcasecmp(argv[j], "xx") && !(ex_flags & TAIR_HASH_SET_NX)) {
+            ex_flags |= TAIR_HASH_SET_XX;
+        } else if (!mstrcasecmp(argv[j], "ex") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_EX;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "exat") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_EX;
+            ex_flags |= TAIR_HASH_SET_ABS_EXPIRE;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "px") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_PX;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "pxat") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_PX;
+            ex_flags |= TAIR_HASH_SET_ABS_EXPIRE;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "ver") && !(ex_flags & TAIR_HASH_SET_WITH_ABS_VER) && !(ex_flags & TAIR_HASH_SET_WITH_GT_VER) && next) {
+            ex_flags |= TAIR_HASH_SET_WITH_VER;
+            version_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "abs") && !(ex_flags & TAIR_HASH_SET_WITH_VER) && !(ex_flags & TAIR_HASH_SET_WITH_GT_VER) && next) {
+            ex_flags |= TAIR_HASH_SET_WITH_ABS_VER;
+            version_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "gt") && !(ex_flags & TAIR_HASH_SET_WITH_VER) && !(ex_flags & TAIR_HASH_SET_WITH_ABS_VER) && next) {
+            ex_flags |= TAIR_HASH_SET_WITH_GT_VER;
+            version_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "keepttl") && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_PX)) {
+            ex_flags |= TAIR_HASH_SET_KEEPTTL;
+        } else {
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            return REDISMODULE_ERR;
+        }
+    }
+
+    /* argv[j] is FIELDS, the field/value pairs start at argv[j + 2]. */
+    if (j == argc || RedisModule_StringToLongLong(argv[j + 1], &numfields) != REDISMODULE_OK || numfields <= 0 || numfields > argc || argc - j - 2 != numfields * 2) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    if (expire_p && (RedisModule_StringToLongLong(expire_p, &expire) != REDISMODULE_OK || expire < 0)) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    if (version_p && (RedisModule_StringToLongLong(version_p, &version) != REDISMODULE_OK || version < 0 || ((ex_flags & (TAIR_HASH_SET_WITH_ABS_VER | TAIR_HASH_SET_WITH_GT_VER)) && version == 0))) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    if (0 < expire) {
+        if (ex_flags & TAIR_HASH_SET_EX) {
+            expire *= 1000;
+        }
+        if (ex_flags & TAIR_HASH_SET_ABS_EXPIRE) {
+            milliseconds = expire;
+        } else {
+            milliseconds = RedisModule_Milliseconds() + expire;
+        }
+    } else if (expire_p && expire == 0) {
+        milliseconds = 1;
+    }
+
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    g_expire_algorithm.passiveExpire(ctx, dbid, argv[1]);
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    /* Look all the fields up first, NX and XX apply to the fields as a whole. */
+    RedisModuleString **fields = RedisModule_Alloc(numfields * sizeof(RedisModuleString *));
+    m_dictEntry **entries = RedisModule_Calloc(numfields, sizeof(m_dictEntry *));
+    for (long long i = 0; i < numfields; i++) {
+        fields[i] = argv[j + 2 + i * 2];
+    }
+
+    tairHashObj *tair_hash_obj = NULL;
+    if (type != REDISMODULE_KEYTYPE_EMPTY) {
+        tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+        lookupFields(ctx, dbid, argv[1], tair_hash_obj, fields, entries, numfields);
+    }
+
+    int skip = 0;
+    for (long long i = 0; i < numfields && !skip; i++) {
+        if (((ex_flags & TAIR_HASH_SET_NX) && entries[i]) || ((ex_flags & TAIR_HASH_SET_XX) && !entries[i])) {
+            skip = 1;
+        }
+    }
+    if (skip) {
+        RedisModule_Free(fields);
+        RedisModule_Free(entries);
+        if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+            RedisModule_CloseKey(key);
+        }
+        return RedisModule_ReplyWithLongLong(ctx, 0);
+    }
+
+    /* Like NX and XX the version applies to the fields as a whole, it is checked against
+     * every existing field before anything is written. VER 0 skips the check. */
+    for (long long i = 0; i < numfields && version_p; i++) {
+        if (entries[i] == NULL) {
+            continue;
+        }
+        long long cur_version = ((TairHashVal *)dictGetVal(entries[i]))->version;
+        if (((ex_flags & TAIR_HASH_SET_WITH_VER) && version != 0 && version != cur_version) || ((ex_flags & TAIR_HASH_SET_WITH_GT_VER) && version <= cur_version)) {
+            RedisModule_Free(fields);
+            RedisModule_Free(entries);
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+            if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+                RedisModule_CloseKey(key);
+            }
+            return REDISMODULE_ERR;
+        }
+    }
+
+    int created = 0;
+    if (tair_hash_obj == NULL) {
+        tair_hash_obj = createTairHashTypeObject();
+        tair_hash_obj->key = RedisModule_CreateStringFromString(NULL, argv[1]);
+        RedisModule_ModuleTypeSetValue(key, TairHashType, tair_hash_obj);
+        created = 1;
+    }
+
+    /* All the fields of a new key share one expire, they are indexed at once when
+     * the algorithm supports it. */
+    long long *bulk_expires = NULL;
+    RedisModuleString **bulk_fields = NULL;
+    size_t bulk_num = 0;
+    if (created && milliseconds > 0 && g_expire_algorithm.bulkInsert) {
+        bulk_expires = RedisModule_Alloc(numfields * sizeof(long long));
+        bulk_fields = RedisModule_Alloc(numfields * sizeof(RedisModuleString *));
+    }
+
+    for (long long i = 0; i < numfields; i++) {
+        m_dictEntry *de = entries[i], *existing;
+        int nokey = 0;
+        if (de == NULL) {
+            de = m_dictAddRaw(tair_hash_obj->hash, takeAndRef(fields[i]), &existing);
+            if (de == NULL) {
+                /* The field is given more than once and has been added above. */
+                RedisModule_FreeString(NULL, fields[i]);
+                de = existing;
+            } else {
+                TairHashVal *tair_hash_val = createTairHashVal();
+                tair_hash_val->expire = 0;
+                tair_hash_val->version = 0;
+                tair_hash_val->value = NULL;
+                dictSetVal(tair_hash_obj->hash, de, tair_hash_val);
+                nokey = 1;
+            }
+        }
+
+        RedisModuleString *skey = dictGetKey(de);
+        TairHashVal *tair_hash_val = dictGetVal(de);
+        if (tair_hash_val->value) {
+            RedisModule_FreeString(NULL, tair_hash_val->value);
+        }
+        tair_hash_val->value = takeAndRef(argv[j + 3 + i * 2]);
+        if (ex_flags & (TAIR_HASH_SET_WITH_ABS_VER | TAIR_HASH_SET_WITH_GT_VER)) {
+            tair_hash_val->version = version;
+        } else {
+            tair_hash_val->version++;
+        }
+
+        if (milliseconds > 0) {
+            if (nokey && bulk_fields) {
+                bulk_expires[bulk_num] = milliseconds;
+                bulk_fields[bulk_num++] = skey;
+            } else if (tair_hash_val->expire == 0) {
+                g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, skey, milliseconds);
+            } else if (tair_hash_val->expire != milliseconds) {
+                g_expire_algorithm.update(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire, milliseconds);
+            }
+            tair_hash_val->expire = milliseconds;
+        } else if (!(ex_flags & TAIR_HASH_SET_KEEPTTL) && tair_hash_val->expire) {
+            g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire);
+            tair_hash_val->expire = 0;
+        }
+    }
+
+    if (bulk_fields) {
+        g_expire_algorithm.bulkInsert(dbid, tair_hash_obj, bulk_expires, bulk_fields, bulk_num);
+        RedisModule_Free(bulk_expires);
+        RedisModule_Free(bulk_fields);
+    }
+    RedisModule_Free(fields);
+    RedisModule_Free(entries);
+
+    /* One command for all the fields, the field/value pairs are reused from argv. NX/XX
+     * and VER are left out, the replica may already see a field as expired and decide
+     * otherwise. The expire is always sent as PXAT and GT as ABS. */
+    RedisModuleString **repl_argv = RedisModule_Alloc((4 + argc - j) * sizeof(RedisModuleString *));
+    int repl_opts = 0, repl_argc;
+    if (expire_p) {
+        repl_argv[repl_opts++] = RedisModule_CreateString(NULL, "PXAT", 4);
+        repl_argv[repl_opts++] = RedisModule_CreateStringFromLongLong(NULL, milliseconds);
+    } else if (ex_flags & TAIR_HASH_SET_KEEPTTL) {
+        repl_argv[repl_opts++] = RedisModule_CreateString(NULL, "KEEPTTL", 7);
+    }
+    if (ex_flags & (TAIR_HASH_SET_WITH_ABS_VER | TAIR_HASH_SET_WITH_GT_VER)) {
+        repl_argv[repl_opts++] = RedisModule_CreateString(NULL, "ABS", 3);
+        repl_argv[repl_opts++] = RedisModule_CreateStringFromLongLong(NULL, version);
+    }
+    for (repl_argc = repl_opts; j < argc; j++) {
+        repl_argv[repl_argc++] = argv[j];
+    }
+    RedisModule_Replicate(ctx, "EXHMSETEX", "sv", argv[1], repl_argv, (size_t)repl_argc);
+    for (int i = 0; i < repl_opts; i++) {
+        RedisModule_FreeString(NULL, repl_argv[i]);
+    }
+    RedisModule_Free(repl_argv);
+
+    RedisModule_CloseKey(key);
+    return RedisModule_ReplyWithLongLong(ctx, 1);
+}
+
+/*  EXHPEXPIREAT <key> <field> <milliseconds-timestamp> [ VER version | ABS version | GT version ]*/
+int TairHashTypeHpexpireAt_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    return tairHashExpireGenericFunc(ctx, argv, argc, 0, UNIT_MILLISECONDS);
+}
+
+/*  EXHPEXPIRE <key> <field> <milliseconds> [ VER version | ABS version | GT version ]*/
+int TairHashTypeHpexpire_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    return tairHashExpireGenericFunc(ctx, argv, argc, RedisModule_Milliseconds(), UNIT_MILLISECONDS);
+}
+
+/*  EXHEXPIREAT <key> <field> <timestamp> [ VER version | ABS version | GT version ] */
+int TairHashTypeHexpireAt_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    return tairHashExpireGenericFunc(ctx, argv, argc, 0, UNIT_SECONDS);
+}
+
+/*  EXHEXPIRE <key> <field> <seconds> [ VER version | ABS version | GT version ] */
+int TairHashTypeHexpire_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    return tairHashExpireGenericFunc(ctx, argv, argc, RedisModule_Milliseconds(), UNIT_SECONDS);
+}
+
+/*  EXHPTTL <key> <field> */
+int TairHashTypeHpttl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    return tairHashTTLGenericFunc(ctx, argv, argc, UNIT_MILLISECONDS);
+}
+
+/*  EXHTTL <key> <field> */
+int TairHashTypeHttl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    return tairHashTTLGenericFunc(ctx, argv, argc, UNIT_SECONDS);
+}
+
+/* EXHPERSIST <key> <field> */
+int TairHashTypeHpersist_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    tairHashObj *tair_hash_obj = NULL;
+    if (type == REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_ReplyWithLongLong(ctx, 0);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_OK;
+    } else {
+        tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+    }
+
+    if (tair_hash_obj == NULL) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INTERNAL_ERR);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    m_dictEntry *de = lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[2]);
+    if (de == NULL) {
+        RedisModule_ReplyWithLongLong(ctx, 0);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_OK;
     }
 
+    TairHashVal *tair_hash_val = dictGetVal(de);
+    if (!tair_hash_val->expire) {
+        RedisModule_ReplyWithLongLong(ctx, 0);
+    } else {
+        g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, dictGetKey(de), tair_hash_val->expire);
+        tair_hash_val->expire = 0;
+        RedisModule_ReplyWithLongLong(ctx, 1);
+    }
+
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
@@ -1216,8 +1705,6 @@ int TairHashTypeHver_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
         return RedisModule_WrongArity(ctx);
     }
 
-    int field_expired = 0;
-
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
@@ -1239,15 +1726,11 @@ int TairHashTypeHver_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     }
 
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0)) {
-        field_expired = 1;
-    }
-
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[2]);
-    if (field_expired || tair_hash_val == NULL) {
+    m_dictEntry *de = lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[2]);
+    if (de == NULL) {
         RedisModule_ReplyWithLongLong(ctx, -2);
     } else {
-        RedisModule_ReplyWithLongLong(ctx, tair_hash_val->version);
+        RedisModule_ReplyWithLongLong(ctx, ((TairHashVal *)dictGetVal(de))->version);
     }
 
     delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
@@ -1256,8 +1739,6 @@ int TairHashTypeHver_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
 
 /*  EXHSETVER <key> <field> <version> */
 int TairHashTypeHsetVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc != 4) {
         return RedisModule_WrongArity(ctx);
     }
@@ -1281,12 +1762,14 @@ int TairHashTypeHsetVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     tairHashObj *tair_hash_obj = NULL;
     if (type == REDISMODULE_KEYTYPE_EMPTY) {
         RedisModule_ReplyWithLongLong(ctx, 0);
+        RedisModule_CloseKey(key);
         return REDISMODULE_OK;
     } else {
         tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
@@ -1294,32 +1777,29 @@ int TairHashTypeHsetVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
 
     if (tair_hash_obj == NULL) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INTERNAL_ERR);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[2]);
-    if (tair_hash_val == NULL) {
-        RedisModule_ReplyWithLongLong(ctx, 0);
-        return REDISMODULE_OK;
-    }
-
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0)) {
-        delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
+    m_dictEntry *de = lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[2]);
+    if (de == NULL) {
+        if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+            RedisModule_CloseKey(key);
+        }
         RedisModule_ReplyWithLongLong(ctx, 0);
         return REDISMODULE_OK;
     }
 
-    tair_hash_val->version = version;
+    ((TairHashVal *)dictGetVal(de))->version = version;
     RedisModule_ReplyWithLongLong(ctx, 1);
     RedisModule_ReplicateVerbatim(ctx);
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
 /* EXHINCRBY <key> <field> <value> [EX time] [EXAT time] [PX time] [PXAT time] [VER version | ABS version | GT version] [MIN minval] [MAX maxval] [KEEPTTL] */
 int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc < 4) {
         return RedisModule_WrongArity(ctx);
     }
@@ -1337,11 +1817,13 @@ int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (RedisModule_StringToLongLong(argv[3], &incr) != REDISMODULE_OK) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_NOT_INTEGER);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1389,42 +1871,50 @@ int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
             ex_flags |= TAIR_HASH_SET_KEEPTTL;
         } else {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
     }
 
     if ((NULL != expire_p) && (RedisModule_StringToLongLong(expire_p, &expire) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (expire_p && expire < 0) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if ((NULL != version_p) && (RedisModule_StringToLongLong(version_p, &version) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (version < 0 || ((ex_flags & (TAIR_HASH_SET_WITH_ABS_VER | TAIR_HASH_SET_WITH_GT_VER)) && version == 0)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if ((NULL != min_p) && (RedisModule_StringToLongLong(min_p, &min))) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INT_MIN_MAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if ((NULL != max_p) && (RedisModule_StringToLongLong(max_p, &max))) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INT_MIN_MAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (NULL != min_p && NULL != max_p && max < min) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_MIN_MAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1440,9 +1930,9 @@ int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
     }
 
     int dbid = RedisModule_GetSelectedDb(ctx);
-    fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0);
+    void *position;
     TairHashVal *tair_hash_val = NULL;
-    m_dictEntry *de = m_dictFind(tair_hash_obj->hash, skey);
+    m_dictEntry *de = lookupFieldForWrite(ctx, dbid, argv[1], tair_hash_obj, skey, &position);
     if (de == NULL) {
         nokey = 1;
         tair_hash_val = createTairHashVal();
@@ -1462,6 +1952,7 @@ int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
     } else {
         if (RedisModule_StringToLongLong(tair_hash_val->value, &cur_val) != REDISMODULE_OK) {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_NOT_INTEGER);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
@@ -1469,11 +1960,13 @@ int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
         if (ex_flags & TAIR_HASH_SET_WITH_VER) {
             if (version != 0 && version != tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         } else if (ex_flags & TAIR_HASH_SET_WITH_GT_VER) {
             if (version <= tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         }
@@ -1484,6 +1977,7 @@ int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
             tairHashValRelease(tair_hash_val);
         }
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_OVERFLOW);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1509,44 +2003,398 @@ int TairHashTypeHincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
         } else {
             milliseconds = RedisModule_Milliseconds() + expire;
         }
-    } else if (expire_p && expire == 0) {
-        milliseconds = 1;
+    } else if (expire_p && expire == 0) {
+        milliseconds = 1;
+    }
+
+    if (milliseconds == 0 && !(ex_flags & TAIR_HASH_SET_KEEPTTL)) {
+        g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire);
+        tair_hash_val->expire = 0;
+    }
+
+    if (milliseconds > 0) {
+        if (nokey || tair_hash_val->expire == 0) {
+            g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, skey, milliseconds);
+        } else {
+            g_expire_algorithm.update(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire, milliseconds);
+        }
+        tair_hash_val->expire = milliseconds;
+    }
+
+    if (nokey) {
+        addFieldAtPosition(tair_hash_obj, skey, tair_hash_val, position);
+    }
+
+    if (milliseconds > 0) {
+        RedisModule_Replicate(ctx, "EXHSET", "sssclcl", argv[1], argv[2], tair_hash_val->value, "abs",
+                              tair_hash_val->version, "pxat", (milliseconds + RedisModule_Milliseconds()));
+    } else {
+        RedisModule_Replicate(ctx, "EXHSET", "ssscl", argv[1], argv[2], tair_hash_val->value, "abs", tair_hash_val->version);
+    }
+
+    RedisModule_ReplyWithLongLong(ctx, cur_val);
+    RedisModule_CloseKey(key);
+    return REDISMODULE_OK;
+}
+
+/* EXHMINCRBY <key> [EX time|EXAT time|PX time|PXAT time|KEEPTTL] [MIN minval] [MAX maxval] FIELDS <numfields> <field> <value> [<field> <value> ...] */
+int TairHashTypeHmincrBy_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc < 5) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long milliseconds = 0, expire = 0, numfields = 0, min = 0, max = 0;
+    RedisModuleString *expire_p = NULL;
+    RedisModuleString *min_p = NULL, *max_p = NULL;
+    int ex_flags = TAIR_HASH_SET_NO_FLAGS;
+    int j;
+
+    for (j = 2; j < argc; j++) {
+        RedisModuleString *next = (j == argc - 1) ? NULL : argv[j + 1];
+        if (!mstrcasecmp(argv[j], "fields") && next) {
+            break;
+        } else if (!mstrcasecmp(argv[j], "ex") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_EX;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "exat") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_EX;
+            ex_flags |= TAIR_HASH_SET_ABS_EXPIRE;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "px") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_PX;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "pxat") && !(ex_flags & TAIR_HASH_SET_PX) && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_KEEPTTL) && next) {
+            ex_flags |= TAIR_HASH_SET_PX;
+            ex_flags |= TAIR_HASH_SET_ABS_EXPIRE;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "min") && next) {
+            ex_flags |= TAIR_HASH_SET_WITH_BOUNDARY;
+            min_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "max") && next) {
+            ex_flags |= TAIR_HASH_SET_WITH_BOUNDARY;
+            max_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "keepttl") && !(ex_flags & TAIR_HASH_SET_EX) && !(ex_flags & TAIR_HASH_SET_PX)) {
+            ex_flags |= TAIR_HASH_SET_KEEPTTL;
+        } else {
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            return REDISMODULE_ERR;
+        }
+    }
+
+    /* argv[j] is FIELDS, the field/increment pairs start at argv[j + 2]. */
+    if (j == argc || RedisModule_StringToLongLong(argv[j + 1], &numfields) != REDISMODULE_OK || numfields <= 0 || numfields > argc || argc - j - 2 != numfields * 2) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    if (expire_p && (RedisModule_StringToLongLong(expire_p, &expire) != REDISMODULE_OK || expire < 0)) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    if ((min_p && RedisModule_StringToLongLong(min_p, &min) != REDISMODULE_OK) || (max_p && RedisModule_StringToLongLong(max_p, &max) != REDISMODULE_OK)) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INT_MIN_MAX);
+        return REDISMODULE_ERR;
+    }
+
+    if (min_p && max_p && max < min) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_MIN_MAX);
+        return REDISMODULE_ERR;
+    }
+
+    /* results[] holds the increments first and then the new values. */
+    long long *results = RedisModule_Alloc(numfields * sizeof(long long));
+    for (long long i = 0; i < numfields; i++) {
+        if (RedisModule_StringToLongLong(argv[j + 3 + i * 2], &results[i]) != REDISMODULE_OK) {
+            RedisModule_Free(results);
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_NOT_INTEGER);
+            return REDISMODULE_ERR;
+        }
+    }
+
+    if (0 < expire) {
+        if (ex_flags & TAIR_HASH_SET_EX) {
+            expire *= 1000;
+        }
+        if (ex_flags & TAIR_HASH_SET_ABS_EXPIRE) {
+            milliseconds = expire;
+        } else {
+            milliseconds = RedisModule_Milliseconds() + expire;
+        }
+    } else if (expire_p && expire == 0) {
+        milliseconds = 1;
+    }
+
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    g_expire_algorithm.passiveExpire(ctx, dbid, argv[1]);
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_Free(results);
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    RedisModuleString **fields = RedisModule_Alloc(numfields * sizeof(RedisModuleString *));
+    m_dictEntry **entries = RedisModule_Calloc(numfields, sizeof(m_dictEntry *));
+    for (long long i = 0; i < numfields; i++) {
+        fields[i] = argv[j + 2 + i * 2];
+    }
+
+    tairHashObj *tair_hash_obj = NULL;
+    if (type != REDISMODULE_KEYTYPE_EMPTY) {
+        tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+        lookupFields(ctx, dbid, argv[1], tair_hash_obj, fields, entries, numfields);
+    }
+
+    /* Compute every new value before touching the hash, so the command either
+     * updates all the fields or none of them. A field given more than once
+     * continues from the value computed for its previous occurrence. */
+    const char *err = NULL;
+    for (long long i = 0; i < numfields && !err; i++) {
+        long long cur_val = 0, incr = results[i], prev;
+        for (prev = i - 1; prev >= 0; prev--) {
+            if (entries[i] ? entries[prev] == entries[i] : (!entries[prev] && !RedisModule_StringCompare(fields[prev], fields[i]))) {
+                break;
+            }
+        }
+        if (prev >= 0) {
+            cur_val = results[prev];
+        } else if (entries[i] && RedisModule_StringToLongLong(((TairHashVal *)dictGetVal(entries[i]))->value, &cur_val) != REDISMODULE_OK) {
+            err = TAIRHASH_ERRORMSG_NOT_INTEGER;
+            break;
+        }
+
+        if ((incr < 0 && cur_val < 0 && incr < (LLONG_MIN - cur_val)) || (incr > 0 && cur_val > 0 && incr > (LLONG_MAX - cur_val)) || (max_p != NULL && cur_val + incr > max) || (min_p != NULL && cur_val + incr < min)) {
+            err = TAIRHASH_ERRORMSG_OVERFLOW;
+            break;
+        }
+        results[i] = cur_val + incr;
+    }
+
+    if (err) {
+        RedisModule_Free(results);
+        RedisModule_Free(fields);
+        RedisModule_Free(entries);
+        RedisModule_ReplyWithError(ctx, err);
+        if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+            RedisModule_CloseKey(key);
+        }
+        return REDISMODULE_ERR;
+    }
+
+    if (tair_hash_obj == NULL) {
+        tair_hash_obj = createTairHashTypeObject();
+        tair_hash_obj->key = RedisModule_CreateStringFromString(NULL, argv[1]);
+        RedisModule_ModuleTypeSetValue(key, TairHashType, tair_hash_obj);
+    }
+
+    for (long long i = 0; i < numfields; i++) {
+        m_dictEntry *de = entries[i], *existing;
+        if (de == NULL) {
+            de = m_dictAddRaw(tair_hash_obj->hash, takeAndRef(fields[i]), &existing);
+            if (de == NULL) {
+                /* The field is given more than once and has been added above. */
+                RedisModule_FreeString(NULL, fields[i]);
+                de = existing;
+            } else {
+                TairHashVal *tair_hash_val = createTairHashVal();
+                tair_hash_val->expire = 0;
+                tair_hash_val->version = 0;
+                tair_hash_val->value = NULL;
+                dictSetVal(tair_hash_obj->hash, de, tair_hash_val);
+            }
+        }
+
+        RedisModuleString *skey = dictGetKey(de);
+        TairHashVal *tair_hash_val = dictGetVal(de);
+        if (tair_hash_val->value) {
+            RedisModule_FreeString(NULL, tair_hash_val->value);
+        }
+        tair_hash_val->value = RedisModule_CreateStringFromLongLong(NULL, results[i]);
+        tair_hash_val->version++;
+
+        if (milliseconds > 0) {
+            if (tair_hash_val->expire == 0) {
+                g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, skey, milliseconds);
+            } else if (tair_hash_val->expire != milliseconds) {
+                g_expire_algorithm.update(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire, milliseconds);
+            }
+            tair_hash_val->expire = milliseconds;
+        } else if (!(ex_flags & TAIR_HASH_SET_KEEPTTL) && tair_hash_val->expire) {
+            g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire);
+            tair_hash_val->expire = 0;
+        }
+        entries[i] = de;
+    }
+
+    /* Replicated as one EXHMSETEX carrying the final values, a field given more
+     * than once is set that many times so its version moves the same way. */
+    RedisModuleString **pairs = RedisModule_Alloc(numfields * 2 * sizeof(RedisModuleString *));
+    for (long long i = 0; i < numfields; i++) {
+        pairs[i * 2] = fields[i];
+        pairs[i * 2 + 1] = ((TairHashVal *)dictGetVal(entries[i]))->value;
+    }
+    if (milliseconds > 0) {
+        RedisModule_Replicate(ctx, "EXHMSETEX", "sclcsv", argv[1], "PXAT", milliseconds, "FIELDS", argv[j + 1], pairs, (size_t)(numfields * 2));
+    } else if (ex_flags & TAIR_HASH_SET_KEEPTTL) {
+        RedisModule_Replicate(ctx, "EXHMSETEX", "sccsv", argv[1], "KEEPTTL", "FIELDS", argv[j + 1], pairs, (size_t)(numfields * 2));
+    } else {
+        RedisModule_Replicate(ctx, "EXHMSETEX", "scsv", argv[1], "FIELDS", argv[j + 1], pairs, (size_t)(numfields * 2));
+    }
+
+    RedisModule_ReplyWithArray(ctx, numfields);
+    for (long long i = 0; i < numfields; i++) {
+        RedisModule_ReplyWithLongLong(ctx, results[i]);
+    }
+
+    RedisModule_Free(pairs);
+    RedisModule_Free(results);
+    RedisModule_Free(fields);
+    RedisModule_Free(entries);
+    RedisModule_CloseKey(key);
+    return REDISMODULE_OK;
+}
+
+/* EXHWINCR <key> <name> <window_ms> <buckets> <delta>
+ * A sliding window counter of `buckets` buckets of window_ms / buckets milliseconds each.
+ * Bucket `b` is kept in the field "<name>:<b>" until it leaves the window, where it expires. */
+int TairHashTypeHwincr_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc != 6) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long window, buckets, delta;
+    if (RedisModule_StringToLongLong(argv[3], &window) != REDISMODULE_OK || RedisModule_StringToLongLong(argv[4], &buckets) != REDISMODULE_OK || buckets <= 0 ||
+        buckets > TAIR_HASH_WINCR_MAX_BUCKETS || window < buckets) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+    if (RedisModule_StringToLongLong(argv[5], &delta) != REDISMODULE_OK) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_NOT_INTEGER);
+        return REDISMODULE_ERR;
+    }
+
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    g_expire_algorithm.passiveExpire(ctx, dbid, argv[1]);
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    long long width = window / buckets, current = RedisModule_Milliseconds() / width;
+    RedisModuleString **fields = RedisModule_Alloc(buckets * sizeof(RedisModuleString *));
+    size_t name_len;
+    const char *name = RedisModule_StringPtrLen(argv[2], &name_len);
+    for (long long i = 0; i < buckets; i++) {
+        fields[i] = RedisModule_CreateStringPrintf(NULL, "%.*s:%lld", (int)name_len, name, current - buckets + 1 + i);
+    }
+
+    /* Sum the buckets in the window, the current one is the last. */
+    tairHashObj *tair_hash_obj = NULL;
+    m_dictEntry *entries[M_DICT_FIND_BATCH], *de = NULL;
+    long long total = 0, cur_val = 0;
+    const char *err = NULL;
+    if (type != REDISMODULE_KEYTYPE_EMPTY) {
+        tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+        for (long long base = 0; base < buckets && !err; base += M_DICT_FIND_BATCH) {
+            int n = buckets - base < M_DICT_FIND_BATCH ? buckets - base : M_DICT_FIND_BATCH;
+            lookupFields(ctx, dbid, argv[1], tair_hash_obj, fields + base, entries, n);
+            for (int i = 0; i < n && !err; i++) {
+                long long val;
+                if (entries[i] == NULL) {
+                    continue;
+                }
+                if (RedisModule_StringToLongLong(((TairHashVal *)dictGetVal(entries[i]))->value, &val) != REDISMODULE_OK) {
+                    err = TAIRHASH_ERRORMSG_NOT_INTEGER;
+                } else if ((val < 0 && total < 0 && val < (LLONG_MIN - total)) || (val > 0 && total > 0 && val > (LLONG_MAX - total))) {
+                    err = TAIRHASH_ERRORMSG_OVERFLOW;
+                } else {
+                    total += val;
+                }
+                if (base + i == buckets - 1) {
+                    de = entries[i];
+                    cur_val = val;
+                }
+            }
+        }
     }
 
-    if (milliseconds == 0 && !(ex_flags & TAIR_HASH_SET_KEEPTTL)) {
-        g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire);
-        tair_hash_val->expire = 0;
+    if (!err && ((delta < 0 && total < 0 && delta < (LLONG_MIN - total)) || (delta > 0 && total > 0 && delta > (LLONG_MAX - total)) ||
+                 (delta < 0 && cur_val < 0 && delta < (LLONG_MIN - cur_val)) || (delta > 0 && cur_val > 0 && delta > (LLONG_MAX - cur_val)))) {
+        err = TAIRHASH_ERRORMSG_OVERFLOW;
     }
 
-    if (milliseconds > 0) {
-        if (nokey || tair_hash_val->expire == 0) {
-            g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, skey, milliseconds);
+    if (!err && delta != 0) {
+        if (tair_hash_obj == NULL) {
+            tair_hash_obj = createTairHashTypeObject();
+            tair_hash_obj->key = RedisModule_CreateStringFromString(NULL, argv[1]);
+            RedisModule_ModuleTypeSetValue(key, TairHashType, tair_hash_obj);
+        }
+
+        long long milliseconds = (current + buckets) * width;
+        RedisModuleString *skey;
+        TairHashVal *tair_hash_val;
+        m_dictEntry *existing;
+        if (de == NULL && (de = m_dictAddRaw(tair_hash_obj->hash, takeAndRef(fields[buckets - 1]), &existing)) != NULL) {
+            skey = dictGetKey(de);
+            tair_hash_val = createTairHashVal();
+            dictSetVal(tair_hash_obj->hash, de, tair_hash_val);
         } else {
+            /* On a writable replica an expired bucket is reported as missing but is still
+             * in the hash, it is reused and starts again from 0. */
+            if (de == NULL) {
+                RedisModule_FreeString(NULL, fields[buckets - 1]);
+                de = existing;
+            }
+            skey = dictGetKey(de);
+            tair_hash_val = dictGetVal(de);
+            RedisModule_FreeString(NULL, tair_hash_val->value);
+        }
+        tair_hash_val->value = RedisModule_CreateStringFromLongLong(NULL, cur_val + delta);
+        tair_hash_val->version++;
+        if (tair_hash_val->expire == 0) {
+            g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, skey, milliseconds);
+        } else if (tair_hash_val->expire != milliseconds) {
             g_expire_algorithm.update(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire, milliseconds);
         }
         tair_hash_val->expire = milliseconds;
+        total += delta;
+
+        RedisModule_Replicate(ctx, "EXHSET", "sssclcl", argv[1], skey, tair_hash_val->value, "ABS", tair_hash_val->version, "PXAT", milliseconds);
     }
 
-    if (nokey) {
-        m_dictAdd(tair_hash_obj->hash, takeAndRef(skey), tair_hash_val);
+    for (long long i = 0; i < buckets; i++) {
+        RedisModule_FreeString(NULL, fields[i]);
     }
+    RedisModule_Free(fields);
 
-    if (milliseconds > 0) {
-        RedisModule_Replicate(ctx, "EXHSET", "sssclcl", argv[1], argv[2], tair_hash_val->value, "abs",
-                              tair_hash_val->version, "pxat", (milliseconds + RedisModule_Milliseconds()));
+    if (err) {
+        RedisModule_ReplyWithError(ctx, err);
     } else {
-        RedisModule_Replicate(ctx, "EXHSET", "ssscl", argv[1], argv[2], tair_hash_val->value, "abs", tair_hash_val->version);
+        RedisModule_ReplyWithLongLong(ctx, total);
     }
-
-    RedisModule_ReplyWithLongLong(ctx, cur_val);
-    return REDISMODULE_OK;
+    if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+        RedisModule_CloseKey(key);
+    }
+    return err ? REDISMODULE_ERR : REDISMODULE_OK;
 }
 
 /* EXHINCRBYFLOAT <key> <field> <value> [EX time] [EXAT time] [PX time] [PXAT time] [VER version | ABS version | GT version] [MIN
  * minval] [MAX maxval] [KEEPTTL] */
 int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc < 4) {
         return RedisModule_WrongArity(ctx);
     }
@@ -1565,11 +2413,13 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (mstring2ld(argv[3], &incr) == REDISMODULE_ERR) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_NOT_FLOAT);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1618,42 +2468,50 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
             ex_flags |= TAIR_HASH_SET_KEEPTTL;
         } else {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
     }
 
     if ((NULL != expire_p) && (RedisModule_StringToLongLong(expire_p, &expire) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (expire_p && expire < 0) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if ((NULL != version_p) && (RedisModule_StringToLongLong(version_p, &version) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (version < 0 || ((ex_flags & (TAIR_HASH_SET_WITH_ABS_VER | TAIR_HASH_SET_WITH_GT_VER)) && version == 0)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if ((NULL != min_p) && (mstring2ld(min_p, &min) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_FLOAT_MIN_MAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if ((NULL != max_p) && (mstring2ld(max_p, &max) != REDISMODULE_OK)) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_FLOAT_MIN_MAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     if (NULL != min_p && NULL != max_p && max < min) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_MIN_MAX);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1668,13 +2526,14 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
 
     if (tair_hash_obj == NULL) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INTERNAL_ERR);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     RedisModuleString *skey = argv[2];
     int dbid = RedisModule_GetSelectedDb(ctx);
-    fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0);
-    m_dictEntry *de = m_dictFind(tair_hash_obj->hash, skey);
+    void *position;
+    m_dictEntry *de = lookupFieldForWrite(ctx, dbid, argv[1], tair_hash_obj, skey, &position);
     TairHashVal *tair_hash_val = NULL;
     if (de == NULL) {
         nokey = 1;
@@ -1695,6 +2554,7 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
     } else {
         if (mstring2ld(tair_hash_val->value, &cur_val) != REDISMODULE_OK) {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_NOT_FLOAT);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
@@ -1702,11 +2562,13 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
         if (ex_flags & TAIR_HASH_SET_WITH_VER) {
             if (version != 0 && version != tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         } else if (ex_flags & TAIR_HASH_SET_WITH_GT_VER) {
             if (version <= tair_hash_val->version) {
                 RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_VERSION);
+                RedisModule_CloseKey(key);
                 return REDISMODULE_ERR;
             }
         }
@@ -1717,6 +2579,7 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
             tairHashValRelease(tair_hash_val);
         }
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_OVERFLOW);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1725,6 +2588,7 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
             tairHashValRelease(tair_hash_val);
         }
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_OVERFLOW);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -1772,7 +2636,7 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
     }
 
     if (nokey) {
-        m_dictAdd(tair_hash_obj->hash, takeAndRef(skey), tair_hash_val);
+        addFieldAtPosition(tair_hash_obj, skey, tair_hash_val, position);
     }
 
     if (milliseconds > 0) {
@@ -1782,6 +2646,7 @@ int TairHashTypeHincrByFloat_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
         RedisModule_Replicate(ctx, "EXHSET", "ssscl", argv[1], argv[2], tair_hash_val->value, "abs", tair_hash_val->version);
     }
     RedisModule_ReplyWithString(ctx, tair_hash_val->value);
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
@@ -1817,20 +2682,158 @@ int TairHashTypeHget_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
 
     RedisModuleString *pkey = argv[1], *skey = argv[2];
 
-    int field_expire = 0;
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0)) {
-        field_expire = 1;
+    m_dictEntry *de = lookupField(ctx, dbid, pkey, tair_hash_obj, skey);
+    if (de == NULL) {
+        RedisModule_ReplyWithNull(ctx);
+    } else {
+        RedisModule_ReplyWithString(ctx, ((TairHashVal *)dictGetVal(de))->value);
+    }
+
+    delEmptyTairHashIfNeeded(ctx, key, pkey, tair_hash_obj);
+    return REDISMODULE_OK;
+}
+
+/* EXHGETDEL <key> <field> */
+int TairHashTypeHgetDel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
     }
 
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, skey);
-    if (field_expire || tair_hash_val == NULL) {
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    if (type == REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    tairHashObj *tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    m_dictEntry *de = unlinkField(ctx, dbid, argv[1], tair_hash_obj, argv[2]);
+    if (de == NULL) {
         RedisModule_ReplyWithNull(ctx);
     } else {
+        TairHashVal *tair_hash_val = dictGetVal(de);
+        if (tair_hash_val->expire > 0) {
+            g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, dictGetKey(de), tair_hash_val->expire);
+        }
         RedisModule_ReplyWithString(ctx, tair_hash_val->value);
+        freeUnlinkedField(ctx, tair_hash_obj, de);
+        RedisModule_Replicate(ctx, "EXHDEL", "ss", argv[1], argv[2]);
     }
 
-    delEmptyTairHashIfNeeded(ctx, key, pkey, tair_hash_obj);
+    if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+        RedisModule_CloseKey(key);
+    }
+    return REDISMODULE_OK;
+}
+
+/* EXHGETEX <key> <field> [EX time|EXAT time|PX time|PXAT time|PERSIST] */
+int TairHashTypeHgetEx_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc < 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long milliseconds = 0, expire = 0;
+    RedisModuleString *expire_p = NULL;
+    int ex_flags = TAIR_HASH_SET_NO_FLAGS, persist = 0;
+
+    for (int j = 3; j < argc; j++) {
+        RedisModuleString *next = (j == argc - 1) ? NULL : argv[j + 1];
+        if (!mstrcasecmp(argv[j], "ex") && !expire_p && !persist && next) {
+            ex_flags |= TAIR_HASH_SET_EX;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "exat") && !expire_p && !persist && next) {
+            ex_flags |= TAIR_HASH_SET_EX;
+            ex_flags |= TAIR_HASH_SET_ABS_EXPIRE;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "px") && !expire_p && !persist && next) {
+            ex_flags |= TAIR_HASH_SET_PX;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "pxat") && !expire_p && !persist && next) {
+            ex_flags |= TAIR_HASH_SET_PX;
+            ex_flags |= TAIR_HASH_SET_ABS_EXPIRE;
+            expire_p = next;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "persist") && !expire_p) {
+            persist = 1;
+        } else {
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            return REDISMODULE_ERR;
+        }
+    }
+
+    if (expire_p && (RedisModule_StringToLongLong(expire_p, &expire) != REDISMODULE_OK || expire < 0)) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    if (0 < expire) {
+        if (ex_flags & TAIR_HASH_SET_EX) {
+            expire *= 1000;
+        }
+        if (ex_flags & TAIR_HASH_SET_ABS_EXPIRE) {
+            milliseconds = expire;
+        } else {
+            milliseconds = RedisModule_Milliseconds() + expire;
+        }
+    } else if (expire_p && expire == 0) {
+        milliseconds = 1;
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    if (type == REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    tairHashObj *tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    m_dictEntry *de = lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[2]);
+    if (de == NULL) {
+        RedisModule_ReplyWithNull(ctx);
+    } else {
+        RedisModuleString *skey = dictGetKey(de);
+        TairHashVal *tair_hash_val = dictGetVal(de);
+        RedisModule_ReplyWithString(ctx, tair_hash_val->value);
+
+        /* Changing the expire is replicated as the command that does it, an expire bumps
+         * the version as EXHPEXPIREAT does, so the version is sent along. */
+        if (milliseconds > 0) {
+            if (tair_hash_val->expire == 0) {
+                g_expire_algorithm.insert(ctx, dbid, argv[1], tair_hash_obj, skey, milliseconds);
+            } else {
+                g_expire_algorithm.update(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire, milliseconds);
+            }
+            tair_hash_val->expire = milliseconds;
+            tair_hash_val->version++;
+            RedisModule_Replicate(ctx, "EXHPEXPIREAT", "sslcl", argv[1], argv[2], milliseconds, "ABS", tair_hash_val->version);
+        } else if (persist && tair_hash_val->expire) {
+            g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, skey, tair_hash_val->expire);
+            tair_hash_val->expire = 0;
+            RedisModule_Replicate(ctx, "EXHPERSIST", "ss", argv[1], argv[2]);
+        }
+    }
+
+    if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+        RedisModule_CloseKey(key);
+    }
     return REDISMODULE_OK;
 }
 
@@ -1863,16 +2866,12 @@ int TairHashTypeHgetWithVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
         return REDISMODULE_ERR;
     }
 
-    int field_expired = 0;
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0)) {
-        field_expired = 1;
-    }
-
-    TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[2]);
-    if (field_expired || tair_hash_val == NULL) {
+    m_dictEntry *de = lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[2]);
+    if (de == NULL) {
         return RedisModule_ReplyWithNull(ctx);
     } else {
+        TairHashVal *tair_hash_val = dictGetVal(de);
         RedisModule_ReplyWithArray(ctx, 2);
         RedisModule_ReplyWithString(ctx, tair_hash_val->value);
         RedisModule_ReplyWithLongLong(ctx, tair_hash_val->version);
@@ -1916,24 +2915,20 @@ int TairHashTypeHmget_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     }
 
     int dbid = RedisModule_GetSelectedDb(ctx);
-    int cn = 0;
-    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
-    for (int ii = 2; ii < argc; ++ii) {
-        if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[ii], 0)) {
-            RedisModule_ReplyWithNull(ctx);
-            ++cn;
-            continue;
-        }
-        TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[ii]);
-        if (tair_hash_val == NULL) {
-            RedisModule_ReplyWithNull(ctx);
-            ++cn;
-        } else {
-            RedisModule_ReplyWithString(ctx, tair_hash_val->value);
-            ++cn;
+    m_dictEntry *entries[M_DICT_FIND_BATCH];
+    RedisModule_ReplyWithArray(ctx, argc - 2);
+    for (int base = 2; base < argc; base += M_DICT_FIND_BATCH) {
+        int n = argc - base < M_DICT_FIND_BATCH ? argc - base : M_DICT_FIND_BATCH;
+        lookupFields(ctx, dbid, argv[1], tair_hash_obj, argv + base, entries, n);
+        for (int ii = 0; ii < n; ++ii) {
+            if (entries[ii] == NULL) {
+                RedisModule_ReplyWithNull(ctx);
+            } else {
+                TairHashVal *tair_hash_val = dictGetVal(entries[ii]);
+                RedisModule_ReplyWithString(ctx, tair_hash_val->value);
+            }
         }
     }
-    RedisModule_ReplySetArrayLength(ctx, cn);
     delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
     return REDISMODULE_OK;
 }
@@ -1972,35 +2967,105 @@ int TairHashTypeHmgetWithVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
     }
 
     int dbid = RedisModule_GetSelectedDb(ctx);
-    int cn = 0;
-    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
-    for (int ii = 2; ii < argc; ++ii) {
-        if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[ii], 0)) {
-            RedisModule_ReplyWithNull(ctx);
-            ++cn;
-            continue;
-        }
-        TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[ii]);
-        if (tair_hash_val == NULL) {
-            RedisModule_ReplyWithNull(ctx);
-            ++cn;
-        } else {
-            RedisModule_ReplyWithArray(ctx, 2);
-            RedisModule_ReplyWithString(ctx, tair_hash_val->value);
-            RedisModule_ReplyWithLongLong(ctx, tair_hash_val->version);
-            ++cn;
+    m_dictEntry *entries[M_DICT_FIND_BATCH];
+    RedisModule_ReplyWithArray(ctx, argc - 2);
+    for (int base = 2; base < argc; base += M_DICT_FIND_BATCH) {
+        int n = argc - base < M_DICT_FIND_BATCH ? argc - base : M_DICT_FIND_BATCH;
+        lookupFields(ctx, dbid, argv[1], tair_hash_obj, argv + base, entries, n);
+        for (int ii = 0; ii < n; ++ii) {
+            if (entries[ii] == NULL) {
+                RedisModule_ReplyWithNull(ctx);
+            } else {
+                TairHashVal *tair_hash_val = dictGetVal(entries[ii]);
+                RedisModule_ReplyWithArray(ctx, 2);
+                RedisModule_ReplyWithString(ctx, tair_hash_val->value);
+                RedisModule_ReplyWithLongLong(ctx, tair_hash_val->version);
+            }
         }
     }
-    RedisModule_ReplySetArrayLength(ctx, cn);
     delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
 
     return REDISMODULE_OK;
 }
 
-/* EXHDEL <key> <field> <field> <field> ...*/
-int TairHashTypeHdel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+/* EXHMGETM key numfields field [field ...] [key numfields field [field ...] ...] */
+int TairHashTypeHmgetM_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
 
+    /* The keys are found by walking the numfields of each group. */
+    if (RedisModule_IsKeysPositionRequest(ctx)) {
+        long long numfields;
+        for (int pos = 1; pos < argc - 1; pos += 2 + numfields) {
+            if (RedisModule_StringToLongLong(argv[pos + 1], &numfields) != REDISMODULE_OK || numfields <= 0) {
+                break;
+            }
+            RedisModule_KeyAtPos(ctx, pos);
+        }
+        return REDISMODULE_OK;
+    }
+
+    if (argc < 4) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    /* Check all the groups and key types first, the reply can not be undone. */
+    int groups = 0;
+    long long numfields;
+    for (int pos = 1; pos < argc; pos += 2 + numfields) {
+        if (pos + 1 >= argc || RedisModule_StringToLongLong(argv[pos + 1], &numfields) != REDISMODULE_OK || numfields <= 0 || numfields > argc - pos - 2) {
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            return REDISMODULE_ERR;
+        }
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[pos], REDISMODULE_READ);
+        int wrongtype = REDISMODULE_KEYTYPE_EMPTY != RedisModule_KeyType(key) && RedisModule_ModuleTypeGetType(key) != TairHashType;
+        RedisModule_CloseKey(key);
+        if (wrongtype) {
+            RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+            return REDISMODULE_ERR;
+        }
+        groups++;
+    }
+
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    m_dictEntry *entries[M_DICT_FIND_BATCH];
+    RedisModule_ReplyWithArray(ctx, groups);
+    for (int pos = 1; pos < argc; pos += 2 + numfields) {
+        RedisModule_StringToLongLong(argv[pos + 1], &numfields);
+        RedisModuleString **fields = argv + pos + 2;
+        RedisModule_ReplyWithArray(ctx, numfields);
+
+        /* A key may be given more than once, it is opened again for each group. */
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[pos], REDISMODULE_READ | REDISMODULE_WRITE);
+        if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+            for (long long i = 0; i < numfields; i++) {
+                RedisModule_ReplyWithNull(ctx);
+            }
+            RedisModule_CloseKey(key);
+            continue;
+        }
+
+        tairHashObj *tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+        for (long long base = 0; base < numfields; base += M_DICT_FIND_BATCH) {
+            int n = numfields - base < M_DICT_FIND_BATCH ? numfields - base : M_DICT_FIND_BATCH;
+            lookupFields(ctx, dbid, argv[pos], tair_hash_obj, fields + base, entries, n);
+            for (int i = 0; i < n; i++) {
+                if (entries[i] == NULL) {
+                    RedisModule_ReplyWithNull(ctx);
+                } else {
+                    TairHashVal *tair_hash_val = dictGetVal(entries[i]);
+                    RedisModule_ReplyWithString(ctx, tair_hash_val->value);
+                }
+            }
+        }
+        if (!delEmptyTairHashIfNeeded(ctx, key, argv[pos], tair_hash_obj)) {
+            RedisModule_CloseKey(key);
+        }
+    }
+    return REDISMODULE_OK;
+}
+
+/* EXHDEL <key> <field> <field> <field> ...*/
+int TairHashTypeHdel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     if (argc < 3) {
         return RedisModule_WrongArity(ctx);
     }
@@ -2011,11 +3076,13 @@ int TairHashTypeHdel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     tairHashObj *tair_hash_obj = NULL;
     if (type == REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
         return RedisModule_ReplyWithLongLong(ctx, 0);
     } else {
         tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
@@ -2025,33 +3092,31 @@ int TairHashTypeHdel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     TairHashVal *tair_hash_val = NULL;
     for (j = 2; j < argc; j++) {
         /* Internal will perform RedisModule_Replicate EXHDEL for replication */
-        fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[j], 0);
-        m_dictEntry *de = m_dictFind(tair_hash_obj->hash, argv[j]);
+        m_dictEntry *de = unlinkField(ctx, dbid, argv[1], tair_hash_obj, argv[j]);
         if (de) {
             tair_hash_val = dictGetVal(de);
             if (tair_hash_val->expire > 0) {
-                g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, argv[j], tair_hash_val->expire);
+                g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, dictGetKey(de), tair_hash_val->expire);
             }
-            m_dictDelete(tair_hash_obj->hash, argv[j]);
-
             RedisModule_Replicate(ctx, "EXHDEL", "ss", argv[1], argv[j]);
+            freeUnlinkedField(ctx, tair_hash_obj, de);
             deleted++;
         }
     }
 
-    delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
+    if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+        RedisModule_CloseKey(key);
+    }
     RedisModule_ReplyWithLongLong(ctx, deleted);
     return REDISMODULE_OK;
 }
 
-/* Since using `RedisModule_Replicate` directly in the timer callback will generate nested MULTIs, we have
- * to generate a new internal command and then use `RedisModule_Call` to call it in the module. It is best
- * not to use this command directly in the client. */
+/* Before redis 6.2, using `RedisModule_Replicate` directly in the timer callback will generate nested MULTIs, so
+ * on these old versions we have to generate a new internal command and then use `RedisModule_Call` to call it in
+ * the module (see canPropagateInTimer). It is best not to use this command directly in the client. */
 
 /* EXHDELREPL <key> <field> */
 int TairHashTypeHdelRepl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc != 3) {
         return RedisModule_WrongArity(ctx);
     }
@@ -2062,11 +3127,13 @@ int TairHashTypeHdelRepl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **a
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     tairHashObj *tair_hash_obj = NULL;
     if (type == REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
         return RedisModule_ReplyWithLongLong(ctx, 0);
     } else {
         tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
@@ -2074,21 +3141,18 @@ int TairHashTypeHdelRepl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **a
 
     int dbid = RedisModule_GetSelectedDb(ctx);
     TairHashVal *tair_hash_val = NULL;
-    m_dictEntry *de = m_dictFind(tair_hash_obj->hash, argv[2]);
-    if (de) {
-        m_dictDelete(tair_hash_obj->hash, argv[2]);
+    if (tairHashDeleteField(ctx, tair_hash_obj, argv[2])) {
         RedisModule_Replicate(ctx, "EXHDEL", "ss", argv[1], argv[2]);
         deleted++;
     }
 
     RedisModule_ReplyWithLongLong(ctx, deleted);
+    RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
 /* EXHDELWITHVER <key> <field> version> <field> <version> ...*/
 int TairHashTypeHdelWithVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-
     if (argc < 4 || ((argc - 2) % 2) != 0) {
         return RedisModule_WrongArity(ctx);
     }
@@ -2099,14 +3163,17 @@ int TairHashTypeHdelWithVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
     int type = RedisModule_KeyType(key);
     if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
         RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
     tairHashObj *tair_hash_obj = NULL;
     if (type == REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
         return RedisModule_ReplyWithLongLong(ctx, 0);
     } else {
         if (RedisModule_ModuleTypeGetType(key) != TairHashType) {
+            RedisModule_CloseKey(key);
             return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
         }
         tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
@@ -2114,6 +3181,7 @@ int TairHashTypeHdelWithVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
 
     if (tair_hash_obj == NULL) {
         RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_INTERNAL_ERR);
+        RedisModule_CloseKey(key);
         return REDISMODULE_ERR;
     }
 
@@ -2124,26 +3192,31 @@ int TairHashTypeHdelWithVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleString
     for (j = 2; j < argc; j += 2) {
         if (RedisModule_StringToLongLong(argv[j + 1], &ver) != REDISMODULE_OK) {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            RedisModule_CloseKey(key);
             return REDISMODULE_ERR;
         }
 
         /* Internal will perform RedisModule_Replicate EXHDEL for replication */
-        fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[j], 0);
-
-        TairHashVal *tair_hash_val = (TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, argv[j]);
-        if (tair_hash_val != NULL) {
+        m_dictEntry *de = unlinkField(ctx, dbid, argv[1], tair_hash_obj, argv[j]);
+        if (de != NULL) {
+            TairHashVal *tair_hash_val = dictGetVal(de);
             if (ver == 0 || ver == tair_hash_val->version) {
                 if (tair_hash_val->expire > 0) {
-                    g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, argv[j], tair_hash_val->expire);
+                    g_expire_algorithm.delete(ctx, dbid, argv[1], tair_hash_obj, dictGetKey(de), tair_hash_val->expire);
                 }
-                m_dictDelete(tair_hash_obj->hash, argv[j]);
                 RedisModule_Replicate(ctx, "EXHDEL", "ss", argv[1], argv[j]);
+                freeUnlinkedField(ctx, tair_hash_obj, de);
                 deleted++;
+            } else {
+                /* The version does not match, the field is kept. */
+                m_dictRelinkUnlinkedEntry(tair_hash_obj->hash, de);
             }
         }
     }
 
-    delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
+    if (!delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj)) {
+        RedisModule_CloseKey(key);
+    }
     RedisModule_ReplyWithLongLong(ctx, deleted);
     return REDISMODULE_OK;
 }
@@ -2189,22 +3262,16 @@ int TairHashTypeHlen_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
         return REDISMODULE_ERR;
     }
 
-    m_dictIterator *di;
-    m_dictEntry *de;
-
-    if (noexp) {
-        TairHashVal *data;
-        di = m_dictGetIterator(tair_hash_obj->hash);
-        while ((de = m_dictNext(di)) != NULL) {
-            data = (TairHashVal *)dictGetVal(de);
-            if (isExpire(data->expire)) {
-                continue;
-            }
-            len++;
-        }
-        m_dictReleaseIterator(di);
-    } else {
-        len = dictSize(tair_hash_obj->hash);
+    /* Only the fields with an expire can be expired, they are all in the expire index
+     * and `max_expire` bounds them, so the hash itself is never walked. */
+    len = dictSize(tair_hash_obj->hash);
+    if (noexp && tair_hash_obj->expire_fields) {
+        long long now = RedisModule_Milliseconds();
+        if (now > tair_hash_obj->max_expire) {
+            len -= tair_hash_obj->expire_fields;
+        } else {
+            len -= g_expire_algorithm.countExpired(tair_hash_obj, now);
+        }
     }
 
     RedisModule_ReplyWithLongLong(ctx, len);
@@ -2241,14 +3308,8 @@ int TairHashTypeHexists_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
         return REDISMODULE_ERR;
     }
 
-    int field_expired = 0;
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0)) {
-        field_expired = 1;
-    }
-
-    TairHashVal *tairHashval = m_dictFetchValue(tair_hash_obj->hash, argv[2]);
-    if (field_expired || tairHashval == NULL) {
+    if (lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[2]) == NULL) {
         RedisModule_ReplyWithLongLong(ctx, 0);
     } else {
         RedisModule_ReplyWithLongLong(ctx, 1);
@@ -2288,17 +3349,13 @@ int TairHashTypeHstrlen_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
         return REDISMODULE_ERR;
     }
 
-    int field_expired = 0;
     size_t len = 0;
     int dbid = RedisModule_GetSelectedDb(ctx);
-    if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, argv[2], 0)) {
-        field_expired = 1;
-    }
-    TairHashVal *val = m_dictFetchValue(tair_hash_obj->hash, argv[2]);
-    if (field_expired || !val) {
+    m_dictEntry *de = lookupField(ctx, dbid, argv[1], tair_hash_obj, argv[2]);
+    if (de == NULL) {
         RedisModule_ReplyWithLongLong(ctx, 0);
     } else {
-        RedisModule_StringPtrLen(val->value, &len);
+        RedisModule_StringPtrLen(((TairHashVal *)dictGetVal(de))->value, &len);
         RedisModule_ReplyWithLongLong(ctx, len);
     }
 
@@ -2306,6 +3363,105 @@ int TairHashTypeHstrlen_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **ar
     return REDISMODULE_OK;
 }
 
+/* A read of a big key served over several event loop iterations, the client is blocked
+ * and the reply is accumulated in a thread safe context bound to it. The key is opened
+ * again before every slice, the read ends early if it has been deleted or replaced. The
+ * object is matched by generation rather than by address, a key deleted and created
+ * again may get the address of the old object back. */
+typedef struct chunkedRead {
+    RedisModuleBlockedClient *bc;
+    RedisModuleCtx *reply_ctx;
+    RedisModuleString *key;
+    int dbid;
+    uint64_t generation;
+    int flags;
+    unsigned long cursor;
+    unsigned long visited;
+    long len;
+} chunkedRead;
+
+static void chunkedReadScanCallback(void *privdata, const m_dictEntry *de) {
+    chunkedRead *r = (chunkedRead *)privdata;
+    TairHashVal *data = dictGetVal(de);
+
+    r->visited++;
+    /* The dict is being scanned, expired fields are left to the expire cycles. */
+    if (isExpire(data->expire)) {
+        return;
+    }
+    if (r->flags & TAIR_HASH_READ_KEYS) {
+        RedisModule_ReplyWithString(r->reply_ctx, dictGetKey(de));
+        r->len++;
+    }
+    if (r->flags & TAIR_HASH_READ_VALUES) {
+        RedisModule_ReplyWithString(r->reply_ctx, data->value);
+        r->len++;
+    }
+    if (r->flags & TAIR_HASH_READ_VERSIONS) {
+        RedisModule_ReplyWithLongLong(r->reply_ctx, data->version);
+        r->len++;
+    }
+}
+
+static void chunkedReadTimerHandler(RedisModuleCtx *ctx, void *data) {
+    chunkedRead *r = (chunkedRead *)data;
+    int done = 1;
+
+    if (RedisModule_SelectDb(ctx, r->dbid) == REDISMODULE_OK) {
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, r->key, REDISMODULE_READ);
+        tairHashObj *obj = NULL;
+        if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY && RedisModule_ModuleTypeGetType(key) == TairHashType) {
+            obj = RedisModule_ModuleTypeGetValue(key);
+        }
+        if (obj && obj->generation == r->generation) {
+            /* The dict is never shrunk, so a field is not returned twice across slices. */
+            r->visited = 0;
+            do {
+                r->cursor = m_dictScan(obj->hash, r->cursor, chunkedReadScanCallback, NULL, r);
+            } while (r->cursor && r->visited < g_expire_algorithm.chunked_read_fields_per_loop);
+            done = r->cursor == 0;
+        }
+        RedisModule_CloseKey(key);
+    }
+
+    if (!done) {
+        RedisModule_CreateTimer(ctx, 0, chunkedReadTimerHandler, r);
+        return;
+    }
+
+    RedisModule_ReplySetArrayLength(r->reply_ctx, r->len);
+    RedisModule_FreeThreadSafeContext(r->reply_ctx);
+    RedisModule_UnblockClient(r->bc, NULL);
+    RedisModule_FreeString(NULL, r->key);
+    RedisModule_Free(r);
+}
+
+/* Serve a read of the whole key over several event loop iterations if the key has at
+ * least `chunked_read_threshold` fields and the client can be blocked. Returns 1 if the
+ * client has been blocked, the reply is then sent once the whole key has been read. */
+static int chunkedReadIfNeeded(RedisModuleCtx *ctx, RedisModuleString *key, tairHashObj *obj, int flags) {
+    if (g_expire_algorithm.chunked_read_threshold == 0 || dictSize(obj->hash) < g_expire_algorithm.chunked_read_threshold) {
+        return 0;
+    }
+    if (RedisModule_GetContextFlags(ctx) & (REDISMODULE_CTX_FLAGS_LUA | REDISMODULE_CTX_FLAGS_MULTI | REDISMODULE_CTX_FLAGS_DENY_BLOCKING)) {
+        return 0;
+    }
+
+    chunkedRead *r = RedisModule_Alloc(sizeof(*r));
+    r->bc = RedisModule_BlockClient(ctx, NULL, NULL, NULL, 0);
+    r->reply_ctx = RedisModule_GetThreadSafeContext(r->bc);
+    r->key = RedisModule_CreateStringFromString(NULL, key);
+    r->dbid = RedisModule_GetSelectedDb(ctx);
+    r->generation = obj->generation;
+    r->flags = flags;
+    r->cursor = 0;
+    r->visited = 0;
+    r->len = 0;
+    RedisModule_ReplyWithArray(r->reply_ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    RedisModule_CreateTimer(ctx, 0, chunkedReadTimerHandler, r);
+    return 1;
+}
+
 /* EXHKEYS key */
 int TairHashTypeHkeys_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
@@ -2314,7 +3470,7 @@ int TairHashTypeHkeys_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
         return RedisModule_WrongArity(ctx);
     }
 
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
 #else
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ);
@@ -2340,6 +3496,10 @@ int TairHashTypeHkeys_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
         return REDISMODULE_ERR;
     }
 
+    if (chunkedReadIfNeeded(ctx, argv[1], tair_hash_obj, TAIR_HASH_READ_KEYS)) {
+        return REDISMODULE_OK;
+    }
+
     TairHashVal *data;
     RedisModuleString *skey;
     uint64_t cn = 0;
@@ -2352,13 +3512,13 @@ int TairHashTypeHkeys_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     di = m_dictGetSafeIterator(tair_hash_obj->hash);
     while ((de = m_dictNext(di)) != NULL) {
         skey = (RedisModuleString *)dictGetKey(de);
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
         data = (TairHashVal *)dictGetVal(de);
         if (isExpire(data->expire)) {
             continue;
         }
 #else
-        if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, skey, 0)) {
+        if (fieldEntryExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, de, 0)) {
             continue;
         }
 #endif
@@ -2367,7 +3527,7 @@ int TairHashTypeHkeys_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     }
     m_dictReleaseIterator(di);
 
-#if !defined(SORT_MODE) && !defined(SLAB_MODE)
+#if !defined(SORT_MODE) && !defined(SLAB_MODE) && !defined(BTREE_MODE)
     delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
 #endif
     RedisModule_ReplySetArrayLength(ctx, cn);
@@ -2381,7 +3541,7 @@ int TairHashTypeHvals_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     if (argc != 2) {
         return RedisModule_WrongArity(ctx);
     }
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
 #else
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ);
@@ -2407,7 +3567,10 @@ int TairHashTypeHvals_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
         return REDISMODULE_ERR;
     }
 
-    RedisModuleString *skey;
+    if (chunkedReadIfNeeded(ctx, argv[1], tair_hash_obj, TAIR_HASH_READ_VALUES)) {
+        return REDISMODULE_OK;
+    }
+
     TairHashVal *data;
     uint64_t cn = 0;
 
@@ -2419,13 +3582,12 @@ int TairHashTypeHvals_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     di = m_dictGetSafeIterator(tair_hash_obj->hash);
     while ((de = m_dictNext(di)) != NULL) {
         data = (TairHashVal *)dictGetVal(de);
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
         if (isExpire(data->expire)) {
             continue;
         }
 #else
-        skey = (RedisModuleString *)dictGetKey(de);
-        if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, skey, 0)) {
+        if (fieldEntryExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, de, 0)) {
             continue;
         }
 #endif
@@ -2434,7 +3596,7 @@ int TairHashTypeHvals_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     }
     m_dictReleaseIterator(di);
 
-#if !defined(SORT_MODE) && !defined(SLAB_MODE)
+#if !defined(SORT_MODE) && !defined(SLAB_MODE) && !defined(BTREE_MODE)
     delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
 #endif
     RedisModule_ReplySetArrayLength(ctx, cn);
@@ -2448,7 +3610,7 @@ int tairHashGetAllGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
         return RedisModule_WrongArity(ctx);
     }
 
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
 #else
     RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ);
@@ -2475,6 +3637,10 @@ int tairHashGetAllGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
         return REDISMODULE_ERR;
     }
 
+    if (chunkedReadIfNeeded(ctx, argv[1], tair_hash_obj, TAIR_HASH_READ_KEYS | TAIR_HASH_READ_VALUES | (returnVer > 0 ? TAIR_HASH_READ_VERSIONS : 0))) {
+        return REDISMODULE_OK;
+    }
+
     TairHashVal *data;
     RedisModuleString *skey;
     uint64_t cn = 0;
@@ -2488,12 +3654,12 @@ int tairHashGetAllGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
     while ((de = m_dictNext(di)) != NULL) {
         skey = (RedisModuleString *)dictGetKey(de);
         data = (TairHashVal *)dictGetVal(de);
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
         if (isExpire(data->expire)) {
             continue;
         }
 #else
-        if (fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, skey, 0)) {
+        if (fieldEntryExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, de, 0)) {
             continue;
         }
 #endif
@@ -2508,7 +3674,7 @@ int tairHashGetAllGenericFunc(RedisModuleCtx *ctx, RedisModuleString **argv, int
     }
     m_dictReleaseIterator(di);
 
-#if !defined(SORT_MODE) && !defined(SLAB_MODE)
+#if !defined(SORT_MODE) && !defined(SLAB_MODE) && !defined(BTREE_MODE)
     delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
 #endif
     RedisModule_ReplySetArrayLength(ctx, cn);
@@ -2525,6 +3691,40 @@ int TairHashTypeHgetAllWithVer_RedisCommand(RedisModuleCtx *ctx, RedisModuleStri
     return tairHashGetAllGenericFunc(ctx, argv, argc, 1);
 }
 
+typedef struct tairHashScanData {
+    list *entries;
+    RedisModuleString *pattern;
+    int flags;
+    long long ttl_below, ttl_above; /* Milliseconds, see TAIR_HASH_SCAN_TTLBELOW/TTLABOVE. */
+    long long now;
+} tairHashScanData;
+
+/* Collect the entries EXHSCAN replies with. Expired fields are kept here and dropped
+ * after the scan, deleting them would change the dict while it is being scanned. */
+void tairhashScanCallback(void *privdata, const m_dictEntry *de) {
+    tairHashScanData *data = (tairHashScanData *)privdata;
+    TairHashVal *sval = dictGetVal(de);
+
+    if (data->pattern && !mstrmatchlen(data->pattern, dictGetKey(de), 0)) {
+        return;
+    }
+
+    if (data->flags & TAIR_HASH_SCAN_NOTTL) {
+        if (sval->expire) {
+            return;
+        }
+    } else if (data->flags & (TAIR_HASH_SCAN_TTLBELOW | TAIR_HASH_SCAN_TTLABOVE)) {
+        if (sval->expire == 0) {
+            return;
+        }
+        long long ttl = sval->expire - data->now;
+        if (((data->flags & TAIR_HASH_SCAN_TTLBELOW) && ttl >= data->ttl_below) || ((data->flags & TAIR_HASH_SCAN_TTLABOVE) && ttl <= data->ttl_above)) {
+            return;
+        }
+    }
+    m_listAddNodeTail(data->entries, (void *)de);
+}
+
 static int parseScanCursor(RedisModuleString *cs, unsigned long *cursor) {
     char *eptr;
 
@@ -2540,11 +3740,11 @@ static int parseScanCursor(RedisModuleString *cs, unsigned long *cursor) {
     return REDISMODULE_OK;
 }
 
-/* EXHSCAN key cursor [MATCH pattern] [COUNT count]*/
+/* EXHSCAN key cursor [MATCH pattern] [COUNT count] [NOVALUES] [WITHTTL] [WITHVER] [NOTTL | TTLBELOW ttl | TTLABOVE ttl] */
 int TairHashTypeHscan_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
 
-    if (argc < 3 || argc > 7) {
+    if (argc < 3) {
         return RedisModule_WrongArity(ctx);
     }
 
@@ -2562,12 +3762,12 @@ int TairHashTypeHscan_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     }
 
     /* Step 1: Parse options. */
-    RedisModuleString *pattern = NULL;
+    tairHashScanData data = {0};
     long long count = TAIR_HASH_SCAN_DEFAULT_COUNT;
     for (int j = 3; j < argc; j++) {
         RedisModuleString *next = (j == argc - 1) ? NULL : argv[j + 1];
         if (!mstrcasecmp(argv[j], "MATCH") && next) {
-            pattern = next;
+            data.pattern = next;
             j++;
         } else if (!mstrcasecmp(argv[j], "COUNT") && next) {
             if (RedisModule_StringToLongLong(next, &count) == REDISMODULE_ERR) {
@@ -2575,6 +3775,28 @@ int TairHashTypeHscan_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
                 return REDISMODULE_ERR;
             }
             j++;
+        } else if (!mstrcasecmp(argv[j], "NOVALUES")) {
+            data.flags |= TAIR_HASH_SCAN_NOVALUES;
+        } else if (!mstrcasecmp(argv[j], "WITHTTL")) {
+            data.flags |= TAIR_HASH_SCAN_WITHTTL;
+        } else if (!mstrcasecmp(argv[j], "WITHVER")) {
+            data.flags |= TAIR_HASH_SCAN_WITHVER;
+        } else if (!mstrcasecmp(argv[j], "NOTTL") && !(data.flags & (TAIR_HASH_SCAN_TTLBELOW | TAIR_HASH_SCAN_TTLABOVE))) {
+            data.flags |= TAIR_HASH_SCAN_NOTTL;
+        } else if (!mstrcasecmp(argv[j], "TTLBELOW") && !(data.flags & TAIR_HASH_SCAN_NOTTL) && next) {
+            if (RedisModule_StringToLongLong(next, &data.ttl_below) == REDISMODULE_ERR) {
+                RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+                return REDISMODULE_ERR;
+            }
+            data.flags |= TAIR_HASH_SCAN_TTLBELOW;
+            j++;
+        } else if (!mstrcasecmp(argv[j], "TTLABOVE") && !(data.flags & TAIR_HASH_SCAN_NOTTL) && next) {
+            if (RedisModule_StringToLongLong(next, &data.ttl_above) == REDISMODULE_ERR) {
+                RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+                return REDISMODULE_ERR;
+            }
+            data.flags |= TAIR_HASH_SCAN_TTLABOVE;
+            j++;
         } else {
             RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
             return REDISMODULE_ERR;
@@ -2599,65 +3821,275 @@ int TairHashTypeHscan_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv
         return REDISMODULE_ERR;
     }
 
-    /* Step 2: Iterate the collection.*/
+    /* Step 2: Iterate the collection, the callback filters by pattern and ttl. */
     long maxiterations = count * 10;
-    list *keys = m_listCreate();
+    list *entries = m_listCreate();
+    data.entries = entries;
+    data.now = RedisModule_Milliseconds();
 
     do {
-        cursor = m_dictScan(tair_hash_obj->hash, cursor, tairhashScanCallback, NULL, keys);
-    } while (cursor && maxiterations-- && listLength(keys) < (unsigned long)count);
-
-    m_listNode *node, *nextnode;
-    node = listFirst(keys);
+        cursor = m_dictScan(tair_hash_obj->hash, cursor, tairhashScanCallback, NULL, &data);
+    } while (cursor && maxiterations-- && listLength(entries) < (unsigned long)count);
 
+    /* Step 3: Filter expired elements, the dict can only be changed once the scan is done. */
     int dbid = RedisModule_GetSelectedDb(ctx);
-    /* Step 3: Filter elements. */
+    m_listNode *node, *nextnode;
+    node = listFirst(entries);
     while (node) {
-        RedisModuleString *skey = listNodeValue(node);
         nextnode = listNextNode(node);
-        int filter = 0;
-
-        /* Filter element if it does not match the pattern. */
-        if (!filter && pattern) {
-            if (!mstrmatchlen(pattern, skey, 0))
-                filter = 1;
+        if (fieldEntryExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, listNodeValue(node), 0)) {
+            m_listDelNode(entries, node);
         }
+        node = nextnode;
+    }
 
-        /* Filter element if it is an expired key. */
-        if (!filter && fieldExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, skey, 0)) {
-            filter = 1;
-        }
+    /* Step 4: Reply to the client. */
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithString(ctx, RedisModule_CreateStringFromLongLong(ctx, cursor));
 
-        /* Remove the element and its associted value if needed. */
-        if (filter) {
-            m_listDelNode(keys, node);
+    long reply_len = 1 + !(data.flags & TAIR_HASH_SCAN_NOVALUES) + !!(data.flags & TAIR_HASH_SCAN_WITHTTL) + !!(data.flags & TAIR_HASH_SCAN_WITHVER);
+    RedisModule_ReplyWithArray(ctx, listLength(entries) * reply_len);
+    long long now = RedisModule_Milliseconds();
+    while ((node = listFirst(entries)) != NULL) {
+        m_dictEntry *de = listNodeValue(node);
+        TairHashVal *tair_hash_val = dictGetVal(de);
+        RedisModule_ReplyWithString(ctx, dictGetKey(de));
+        if (!(data.flags & TAIR_HASH_SCAN_NOVALUES)) {
+            RedisModule_ReplyWithString(ctx, tair_hash_val->value);
         }
+        if (data.flags & TAIR_HASH_SCAN_WITHTTL) {
+            if (tair_hash_val->expire == 0) {
+                RedisModule_ReplyWithLongLong(ctx, -1);
+            } else {
+                RedisModule_ReplyWithLongLong(ctx, tair_hash_val->expire > now ? tair_hash_val->expire - now : 0);
+            }
+        }
+        if (data.flags & TAIR_HASH_SCAN_WITHVER) {
+            RedisModule_ReplyWithLongLong(ctx, tair_hash_val->version);
+        }
+        m_listDelNode(entries, node);
+    }
 
-        node = nextnode;
-        nextnode = listNextNode(node);
-        if (filter) {
-            m_listDelNode(keys, node);
+    m_listRelease(entries);
+    delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
+    return REDISMODULE_OK;
+}
+
+/* EXHRANGEBYTTL key min max [WITHVALUES] [LIMIT offset count] */
+int TairHashTypeHrangeByTtl_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 4) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long min, max, offset = 0, count = -1;
+    int withvalues = 0;
+    if (RedisModule_StringToLongLong(argv[2], &min) != REDISMODULE_OK || RedisModule_StringToLongLong(argv[3], &max) != REDISMODULE_OK || min < 0) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    for (int j = 4; j < argc; j++) {
+        if (!mstrcasecmp(argv[j], "WITHVALUES")) {
+            withvalues = 1;
+        } else if (!mstrcasecmp(argv[j], "LIMIT") && j + 2 < argc) {
+            if (RedisModule_StringToLongLong(argv[j + 1], &offset) != REDISMODULE_OK || RedisModule_StringToLongLong(argv[j + 2], &count) != REDISMODULE_OK || offset < 0) {
+                RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+                return REDISMODULE_ERR;
+            }
+            j += 2;
+        } else {
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            return REDISMODULE_ERR;
         }
+    }
 
-        node = nextnode;
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        return REDISMODULE_ERR;
     }
 
-    /* Step 4: Reply to the client. */
-    RedisModule_ReplyWithArray(ctx, 2);
-    RedisModule_ReplyWithString(ctx, RedisModule_CreateStringFromLongLong(ctx, cursor));
+    tairHashObj *tair_hash_obj = type == REDISMODULE_KEYTYPE_EMPTY ? NULL : RedisModule_ModuleTypeGetValue(key);
+    if (tair_hash_obj == NULL || tair_hash_obj->expire_fields == 0 || max < min || count == 0) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
 
-    RedisModule_ReplyWithArray(ctx, listLength(keys));
-    while ((node = listFirst(keys)) != NULL) {
-        RedisModuleString *skey = listNodeValue(node);
-        RedisModule_ReplyWithString(ctx, skey);
-        m_listDelNode(keys, node);
+    /* min and max are ttls in milliseconds, fields which are already due are left to
+     * the expire cycles. */
+    long long now = RedisModule_Milliseconds();
+    long long from = min > LLONG_MAX - now ? LLONG_MAX : now + (min ? min : 1);
+    long long to = max > LLONG_MAX - now ? LLONG_MAX : now + max;
+
+    /* The index may hold entries that are gone or outside the window by their exact
+     * expire, so entries are checked against the hash first and OFFSET and LIMIT only
+     * count the ones left. With `expire_granularity` the index only knows the buckets
+     * and the fields of a bucket are in no order, so the whole window is read and
+     * sorted by exact expire, otherwise the read grows until enough entries are left. */
+    size_t total = tair_hash_obj->expire_fields;
+    size_t want = total;
+    if (count > 0 && (unsigned long long)offset + count < want) {
+        want = offset + count;
+    }
+    if ((unsigned long long)offset >= want) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+#if defined(SORT_MODE)
+    int bucketed = g_expire_algorithm.expire_granularity > 1;
+#else
+    int bucketed = 0;
+#endif
+    size_t limit = bucketed ? total : want, n, k;
+    long long *expires = RedisModule_Alloc(limit * sizeof(long long));
+    RedisModuleString **fields = RedisModule_Alloc(limit * sizeof(RedisModuleString *));
+    int dbid = RedisModule_GetSelectedDb(ctx);
+    while (1) {
+        n = g_expire_algorithm.rangeByExpire(tair_hash_obj, from, to, expires, fields, limit);
+        k = 0;
+        for (size_t i = 0; i < n; i++) {
+            m_dictEntry *de = m_dictFind(tair_hash_obj->hash, fields[i]);
+            if (de == NULL || fieldEntryExpireIfNeeded(ctx, dbid, argv[1], tair_hash_obj, de, 0)) {
+                continue;
+            }
+            long long expire = ((TairHashVal *)dictGetVal(de))->expire;
+            if (expire < from || expire > to) {
+                continue;
+            }
+            expires[k] = expire;
+            fields[k++] = dictGetKey(de);
+        }
+        if (k >= want || n < limit || limit >= total) {
+            break;
+        }
+        limit = limit * 2 < total ? limit * 2 : total;
+        expires = RedisModule_Realloc(expires, limit * sizeof(long long));
+        fields = RedisModule_Realloc(fields, limit * sizeof(RedisModuleString *));
+    }
+    if (bucketed) {
+        m_btreeSortEntries(expires, fields, k);
     }
+    if (k > want) {
+        k = want;
+    }
+
+    long cn = 0;
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    for (size_t i = offset; i < k; i++) {
+        RedisModule_ReplyWithString(ctx, fields[i]);
+        cn++;
+        if (withvalues) {
+            RedisModule_ReplyWithString(ctx, ((TairHashVal *)m_dictFetchValue(tair_hash_obj->hash, fields[i]))->value);
+            cn++;
+        }
+    }
+    RedisModule_ReplySetArrayLength(ctx, cn);
 
-    m_listRelease(keys);
+    RedisModule_Free(expires);
+    RedisModule_Free(fields);
     delEmptyTairHashIfNeeded(ctx, key, argv[1], tair_hash_obj);
     return REDISMODULE_OK;
 }
 
+/* EXHAGG <key> SUM|MIN|MAX|COUNT [MATCH pattern]
+ * Aggregate the finite numeric values of the live fields, the other values are skipped. */
+int TairHashTypeHagg_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3 && argc != 5) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    int op;
+    if (!mstrcasecmp(argv[2], "sum")) {
+        op = TAIR_HASH_AGG_SUM;
+    } else if (!mstrcasecmp(argv[2], "min")) {
+        op = TAIR_HASH_AGG_MIN;
+    } else if (!mstrcasecmp(argv[2], "max")) {
+        op = TAIR_HASH_AGG_MAX;
+    } else if (!mstrcasecmp(argv[2], "count")) {
+        op = TAIR_HASH_AGG_COUNT;
+    } else {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+
+    RedisModuleString *pattern = NULL;
+    if (argc == 5) {
+        if (mstrcasecmp(argv[3], "match")) {
+            RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_SYNTAX);
+            return REDISMODULE_ERR;
+        }
+        pattern = argv[4];
+        /* "*" matches everything, skip the match then. */
+        size_t len;
+        const char *p = RedisModule_StringPtrLen(pattern, &len);
+        if (len == 1 && p[0] == '*') {
+            pattern = NULL;
+        }
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ);
+    int type = RedisModule_KeyType(key);
+    if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != TairHashType) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        return REDISMODULE_ERR;
+    }
+
+    long long count = 0;
+    long double result = 0;
+    if (type != REDISMODULE_KEYTYPE_EMPTY) {
+        tairHashObj *tair_hash_obj = RedisModule_ModuleTypeGetValue(key);
+        long long now = RedisModule_Milliseconds();
+        m_dictIterator *di = m_dictGetIterator(tair_hash_obj->hash);
+        m_dictEntry *de;
+        while ((de = m_dictNext(di)) != NULL) {
+            TairHashVal *tair_hash_val = dictGetVal(de);
+            if (tair_hash_val->expire && now > tair_hash_val->expire) {
+                continue;
+            }
+            if (pattern && !mstrmatchlen(pattern, dictGetKey(de), 0)) {
+                continue;
+            }
+
+            /* Most counters are integers, which are parsed without going through strtold. */
+            long long ll;
+            long double val;
+            if (RedisModule_StringToLongLong(tair_hash_val->value, &ll) == REDISMODULE_OK) {
+                val = ll;
+            } else if (mstring2ld(tair_hash_val->value, &val) != REDISMODULE_OK || isnan(val) || isinf(val)) {
+                /* "inf" and "nan" are parsed by strtold but can not be aggregated. */
+                continue;
+            }
+
+            if (op == TAIR_HASH_AGG_SUM) {
+                result += val;
+            } else if ((op == TAIR_HASH_AGG_MIN && (count == 0 || val < result)) || (op == TAIR_HASH_AGG_MAX && (count == 0 || val > result))) {
+                result = val;
+            }
+            count++;
+        }
+        m_dictReleaseIterator(di);
+    }
+
+    if (op == TAIR_HASH_AGG_COUNT) {
+        return RedisModule_ReplyWithLongLong(ctx, count);
+    }
+    if (op != TAIR_HASH_AGG_SUM && count == 0) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+    if (isnan(result) || isinf(result)) {
+        RedisModule_ReplyWithError(ctx, TAIRHASH_ERRORMSG_OVERFLOW);
+        return REDISMODULE_ERR;
+    }
+
+    char dbuf[MAX_LONG_DOUBLE_CHARS] = {0};
+    int dlen = m_ld2string(dbuf, sizeof(dbuf), result, 1);
+    return RedisModule_ReplyWithStringBuffer(ctx, dbuf, dlen);
+}
+
 /* exhexpireinfo */
 int TairHashTypeActiveExpireInfo_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     REDISMODULE_NOT_USED(argv);
@@ -2679,7 +4111,18 @@ int TairHashTypeActiveExpireInfo_RedisCommand(RedisModuleCtx *ctx, RedisModuleSt
         "tair_hash_active_expire_last_time_msec:%ld\r\n"
         "tair_hash_active_expire_max_time_msec:%ld\r\n"
         "tair_hash_active_expire_avg_time_msec:%ld\r\n"
-        "tair_hash_passive_expire_keys_per_loop:%ld\r\n",
+        "tair_hash_passive_expire_keys_per_loop:%ld\r\n"
+        "tair_hash_whole_key_expired_keys:%ld\r\n"
+        "tair_hash_memory_pressure_ratio:%ld\r\n"
+        "tair_hash_memory_pressure_level:%ld\r\n"
+        "tair_hash_effective_active_expire_period:%ld\r\n"
+        "tair_hash_effective_active_expire_keys_per_loop:%ld\r\n"
+        "tair_hash_effective_passive_expire_keys_per_loop:%ld\r\n"
+        "tair_hash_lazyfree_threshold:%ld\r\n"
+        "tair_hash_lazyfree_max_pending:%ld\r\n"
+        "tair_hash_lazyfree_pending_objects:%ld\r\n"
+        "tair_hash_lazyfree_freed_objects:%ld\r\n"
+        "tair_hash_lazyfree_sync_freed_objects:%ld\r\n",
         (long)g_expire_algorithm.enable_active_expire,
         (long)g_expire_algorithm.active_expire_period,
         (long)g_expire_algorithm.keys_per_active_loop,
@@ -2687,7 +4130,18 @@ int TairHashTypeActiveExpireInfo_RedisCommand(RedisModuleCtx *ctx, RedisModuleSt
         (long)g_expire_algorithm.stat_last_active_expire_time_msec,
         (long) g_expire_algorithm.stat_max_active_expire_time_msec,
         (long)g_expire_algorithm.stat_avg_active_expire_time_msec,
-        (long)g_expire_algorithm.keys_per_passive_loop);
+        (long)g_expire_algorithm.keys_per_passive_loop,
+        (long)g_expire_algorithm.stat_whole_key_expired,
+        (long)g_expire_algorithm.memory_pressure_ratio,
+        (long)g_expire_algorithm.memory_pressure_level,
+        (long)g_expire_algorithm.effective_active_expire_period,
+        (long)g_expire_algorithm.effective_keys_per_active_loop,
+        (long)g_expire_algorithm.effective_keys_per_passive_loop,
+        (long)g_expire_algorithm.lazyfree_threshold,
+        (long)g_expire_algorithm.lazyfree_max_pending,
+        (long)lazyfreeGetPendingObjects(),
+        (long)lazyfreeGetFreedObjects(),
+        (long)lazyfreeGetSyncFreedObjects());
 
     size_t a_len, d_len, t_size = 0;
     const char *a_buf = RedisModule_StringPtrLen(info_a, &a_len);
@@ -2702,7 +4156,7 @@ int TairHashTypeActiveExpireInfo_RedisCommand(RedisModuleCtx *ctx, RedisModuleSt
     strncat(buf, DB_DETAIL, d_len);
     t_size += d_len;
 
-    for (int i = 0; i < DB_NUM; ++i) {
+    for (int i = 0; i < g_expire_algorithm.db_num; ++i) {
         if (g_expire_algorithm.stat_active_expired_field[i] == 0 && g_expire_algorithm.stat_passive_expired_field[i] == 0) {
             continue;
         }
@@ -2733,6 +4187,15 @@ void *TairHashTypeRdbLoad(RedisModuleIO *rdb, int encver) {
     long long version, expire;
     RedisModuleString *value;
 
+    /* Expire fields are collected and indexed at once if the algorithm supports it. */
+    long long *expires = NULL;
+    RedisModuleString **expire_fields = NULL;
+    size_t expire_num = 0;
+    if (g_expire_algorithm.bulkInsert && len) {
+        expires = RedisModule_Alloc(len * sizeof(long long));
+        expire_fields = RedisModule_Alloc(len * sizeof(RedisModuleString *));
+    }
+
     while (len--) {
         skey = RedisModule_LoadString(rdb);
         version = RedisModule_LoadUnsigned(rdb);
@@ -2744,12 +4207,25 @@ void *TairHashTypeRdbLoad(RedisModuleIO *rdb, int encver) {
         hashv->value = takeAndRef(value);
         m_dictAdd(o->hash, takeAndRef(skey), hashv);
         if (hashv->expire) {
-            g_expire_algorithm.insert(NULL, dbid, NULL, o, skey, hashv->expire);
+            if (expire_fields) {
+                expires[expire_num] = hashv->expire;
+                expire_fields[expire_num++] = skey;
+            } else {
+                g_expire_algorithm.insert(NULL, dbid, NULL, o, skey, hashv->expire);
+            }
         }
         RedisModule_FreeString(NULL, value);
         RedisModule_FreeString(NULL, skey);
     }
 
+    if (expire_fields) {
+        if (expire_num) {
+            g_expire_algorithm.bulkInsert(dbid, o, expires, expire_fields, expire_num);
+        }
+        RedisModule_Free(expires);
+        RedisModule_Free(expire_fields);
+    }
+
     return o;
 }
 
@@ -2810,7 +4286,7 @@ void TairHashTypeFree(void *value) {
     }
 }
 
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
 
 size_t TairHashTypeMemUsage2(RedisModuleKeyOptCtx *ctx, const void *value) {
     tairHashObj *o = (tairHashObj *)value;
@@ -2844,7 +4320,14 @@ size_t TairHashTypeMemUsage2(RedisModuleKeyOptCtx *ctx, const void *value) {
     }
 
     if (o->expire_index) {
+#if defined(BTREE_MODE)
+        size += m_btreeMemUsage(o->expire_index);
+#elif defined(SLAB_MODE)
         size += o->expire_index->length * sizeof(m_zskiplistNode);
+#else
+        /* The index thread owns the pool, estimate from the number of expire fields. */
+        size += g_expire_algorithm.index_thread ? o->expire_fields * sizeof(m_zskiplistNode) : m_zslMemUsage(o->expire_index);
+#endif
     }
 
     return size;
@@ -2855,14 +4338,8 @@ void TairHashTypeUnlink2(RedisModuleKeyOptCtx *ctx, const void *value) {
 
     int dbid = RedisModule_GetDbIdFromOptCtx(ctx);
 
-    if (o->expire_index->length) {
-        /* UNLINK is a synchronous call, so ExpireNode can be safely deleted here. */
-#ifdef SLAB_MODE
-        m_zslDelete(g_expire_index[dbid], o->expire_index->header->level[0].forward->expire_min, o->key, NULL);
-#else
-        m_zslDelete(g_expire_index[dbid], o->expire_index->header->level[0].forward->score, o->key, NULL);
-#endif
-    }
+    /* UNLINK is a synchronous call, so ExpireNode can be safely deleted here. */
+    globalExpireIndexDelete(dbid, o);
 }
 
 void *TairHashTypeCopy2(RedisModuleKeyOptCtx *ctx, const void *value) {
@@ -2875,6 +4352,15 @@ void *TairHashTypeCopy2(RedisModuleKeyOptCtx *ctx, const void *value) {
     new->key = RedisModule_CreateStringFromString(NULL, tokey);
     m_dictExpand(new->hash, dictSize(old->hash));
 
+    /* Expire fields are collected and indexed at once if the algorithm supports it. */
+    long long *expires = NULL;
+    RedisModuleString **expire_fields = NULL;
+    size_t expire_num = 0;
+    if (g_expire_algorithm.bulkInsert && old->expire_fields) {
+        expires = RedisModule_Alloc(old->expire_fields * sizeof(long long));
+        expire_fields = RedisModule_Alloc(old->expire_fields * sizeof(RedisModuleString *));
+    }
+
     /* Copy hash. */
     m_dictIterator *di;
     m_dictEntry *de;
@@ -2889,16 +4375,27 @@ void *TairHashTypeCopy2(RedisModuleKeyOptCtx *ctx, const void *value) {
         newval->value = RedisModule_CreateStringFromString(NULL, oldval->value);
         m_dictAdd(new->hash, field, newval);
         if (newval->expire) {
-            g_expire_algorithm.insert(NULL, to_dbid, NULL, new, field, newval->expire);
+            if (expire_fields) {
+                expires[expire_num] = newval->expire;
+                expire_fields[expire_num++] = field;
+            } else {
+                g_expire_algorithm.insert(NULL, to_dbid, NULL, new, field, newval->expire);
+            }
         }
     }
     m_dictReleaseIterator(di);
+
+    if (expire_fields) {
+        g_expire_algorithm.bulkInsert(to_dbid, new, expires, expire_fields, expire_num);
+        RedisModule_Free(expires);
+        RedisModule_Free(expire_fields);
+    }
     return new;
 }
 
 size_t TairHashTypeEffort2(RedisModuleKeyOptCtx *ctx, const void *value) {
     tairHashObj *o = (tairHashObj *)value;
-    return dictSize(o->hash) + o->expire_index->length;
+    return dictSize(o->hash) + o->expire_fields;
 }
 #else
 
@@ -2934,7 +4431,14 @@ size_t TairHashTypeMemUsage(const void *value) {
     }
 
     if (o->expire_index) {
+#if defined(BTREE_MODE)
+        size += m_btreeMemUsage(o->expire_index);
+#elif defined(SLAB_MODE)
         size += o->expire_index->length * sizeof(m_zskiplistNode);
+#else
+        /* The index thread owns the pool, estimate from the number of expire fields. */
+        size += g_expire_algorithm.index_thread ? o->expire_fields * sizeof(m_zskiplistNode) : m_zslMemUsage(o->expire_index);
+#endif
     }
 
     return size;
@@ -2943,7 +4447,7 @@ size_t TairHashTypeMemUsage(const void *value) {
 size_t TairHashTypeEffort(RedisModuleString *key, const void *value) {
     REDISMODULE_NOT_USED(key);
     tairHashObj *o = (tairHashObj *)value;
-    return dictSize(o->hash) + o->expire_index->length;
+    return dictSize(o->hash) + o->expire_fields;
 }
 
 #endif
@@ -2996,10 +4500,13 @@ int Module_CreateCommands(RedisModuleCtx *ctx) {
     CREATE_WRCMD("exhdelrepl", TairHashTypeHdelRepl_RedisCommand)
     CREATE_WRCMD("exhdelwithver", TairHashTypeHdelWithVer_RedisCommand)
     CREATE_WRCMD("exhincrby", TairHashTypeHincrBy_RedisCommand)
+    CREATE_WRCMD("exhmincrby", TairHashTypeHmincrBy_RedisCommand)
+    CREATE_WRCMD("exhwincr", TairHashTypeHwincr_RedisCommand)
     CREATE_WRCMD("exhincrbyfloat", TairHashTypeHincrByFloat_RedisCommand)
     CREATE_WRCMD("exhsetnx", TairHashTypeHsetNx_RedisCommand)
     CREATE_WRCMD("exhmset", TairHashTypeHmset_RedisCommand)
     CREATE_WRCMD("exhmsetwithopts", TairHashTypeHmsetWithOpts_RedisCommand)
+    CREATE_WRCMD("exhmsetex", TairHashTypeHmsetEx_RedisCommand)
     CREATE_WRCMD("exhsetver", TairHashTypeHsetVer_RedisCommand)
     CREATE_WRCMD("exhexpire", TairHashTypeHexpire_RedisCommand)
     CREATE_WRCMD("exhexpireat", TairHashTypeHexpireAt_RedisCommand)
@@ -3018,16 +4525,50 @@ int Module_CreateCommands(RedisModuleCtx *ctx) {
     CREATE_ROCMD("exhgetallwithver", TairHashTypeHgetAllWithVer_RedisCommand)
     CREATE_ROCMD("exhmget", TairHashTypeHmget_RedisCommand)
     CREATE_ROCMD("exhmgetwithver", TairHashTypeHmgetWithVer_RedisCommand)
+    CREATE_CMD("exhmgetm", TairHashTypeHmgetM_RedisCommand, "readonly getkeys-api", 1, 1, 1)
     CREATE_ROCMD("exhscan", TairHashTypeHscan_RedisCommand)
+    CREATE_ROCMD("exhrangebyttl", TairHashTypeHrangeByTtl_RedisCommand)
+    CREATE_CMD("exhagg", TairHashTypeHagg_RedisCommand, "readonly", 1, 1, 1)
     CREATE_ROCMD("exhver", TairHashTypeHver_RedisCommand)
     CREATE_ROCMD("exhttl", TairHashTypeHttl_RedisCommand)
     CREATE_ROCMD("exhpttl", TairHashTypeHpttl_RedisCommand)
     CREATE_ROCMD("exhgetwithver", TairHashTypeHgetWithVer_RedisCommand)
+    CREATE_WRCMD("exhgetdel", TairHashTypeHgetDel_RedisCommand)
+    CREATE_WRCMD("exhgetex", TairHashTypeHgetEx_RedisCommand)
     CREATE_ROMCMD("exhexpireinfo", TairHashTypeActiveExpireInfo_RedisCommand, 0, 0, 0)
 
     return REDISMODULE_OK;
 }
 
+/* Read the number of databases from the server config, so that the per-db expire
+ * structures match the server instead of a hard-coded value. */
+static int getServerDbNum(RedisModuleCtx *ctx) {
+    int db_num = TAIR_HASH_DEFAULT_DB_NUM;
+    RedisModuleCallReply *reply = RedisModule_Call(ctx, "CONFIG", "cc", "GET", "databases");
+    if (reply == NULL) {
+        return db_num;
+    }
+
+    if (RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ARRAY && RedisModule_CallReplyLength(reply) == 2) {
+        RedisModuleCallReply *val_reply = RedisModule_CallReplyArrayElement(reply, 1);
+        if (RedisModule_CallReplyType(val_reply) == REDISMODULE_REPLY_STRING) {
+            size_t len;
+            const char *ptr = RedisModule_CallReplyStringPtr(val_reply, &len);
+            char buf[32];
+            if (len < sizeof(buf)) {
+                memcpy(buf, ptr, len);
+                buf[len] = '\0';
+                long v = strtol(buf, NULL, 10);
+                if (v > 0 && v <= INT_MAX) {
+                    db_num = (int)v;
+                }
+            }
+        }
+    }
+    RedisModule_FreeCallReply(reply);
+    return db_num;
+}
+
 int __attribute__((visibility("default"))) RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     REDISMODULE_NOT_USED(argv);
     REDISMODULE_NOT_USED(argc);
@@ -3047,18 +4588,28 @@ int __attribute__((visibility("default"))) RedisModule_OnLoad(RedisModuleCtx *ct
         redis_major_ver = (version & 0x00ff0000) >> 16;
     }
 
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
     if (redis_major_ver < 7) {
         RedisModule_Log(ctx, "warning", "Redis version (%d.%d.%d) is too old, please upgrade to 7.0.0 or above", redis_major_ver, redis_minor_ver, redis_patch_ver);
         return REDISMODULE_ERR;
     }
 #endif
 
+    g_expire_algorithm.db_num = getServerDbNum(ctx);
+    g_expire_algorithm.stat_active_expired_field = RedisModule_Calloc(g_expire_algorithm.db_num, sizeof(uint64_t));
+    g_expire_algorithm.stat_passive_expired_field = RedisModule_Calloc(g_expire_algorithm.db_num, sizeof(uint64_t));
+
     g_expire_algorithm.enable_active_expire = 1;
     g_expire_algorithm.active_expire_period = TAIR_HASH_ACTIVE_EXPIRE_PERIOD;
     g_expire_algorithm.dbs_per_active_loop = TAIR_HASH_ACTIVE_DBS_PER_CALL;
     g_expire_algorithm.keys_per_active_loop = TAIR_HASH_ACTIVE_EXPIRE_KEYS_PER_LOOP;
     g_expire_algorithm.keys_per_passive_loop = TAIR_HASH_PASSIVE_EXPIRE_KEYS_PER_LOOP;
+    g_expire_algorithm.lazyfree_threshold = TAIR_HASH_LAZYFREE_THRESHOLD;
+    g_expire_algorithm.lazyfree_max_pending = TAIR_HASH_LAZYFREE_MAX_PENDING;
+    g_expire_algorithm.expire_granularity = TAIR_HASH_EXPIRE_GRANULARITY;
+    g_expire_algorithm.memory_pressure_ratio = TAIR_HASH_MEMORY_PRESSURE_RATIO;
+    g_expire_algorithm.chunked_read_threshold = TAIR_HASH_CHUNKED_READ_THRESHOLD;
+    g_expire_algorithm.chunked_read_fields_per_loop = TAIR_HASH_CHUNKED_READ_FIELDS_PER_LOOP;
 
     for (int ii = 0; ii < argc; ii += 2) {
         if (!mstrcasecmp(argv[ii], "enable_active_expire")) {
@@ -3096,6 +4647,61 @@ int __attribute__((visibility("default"))) RedisModule_OnLoad(RedisModuleCtx *ct
                 return REDISMODULE_ERR;
             }
             g_expire_algorithm.keys_per_passive_loop = v;
+        } else if (!mstrcasecmp(argv[ii], "lazyfree_threshold")) {
+            long long v;
+            if (RedisModule_StringToLongLong(argv[ii + 1], &v) == REDISMODULE_ERR || v < 0) {
+                RedisModule_Log(ctx, "warning", "Invalid argument for lazyfree_threshold");
+                return REDISMODULE_ERR;
+            }
+            g_expire_algorithm.lazyfree_threshold = v;
+        } else if (!mstrcasecmp(argv[ii], "lazyfree_max_pending")) {
+            long long v;
+            if (RedisModule_StringToLongLong(argv[ii + 1], &v) == REDISMODULE_ERR || v < 0) {
+                RedisModule_Log(ctx, "warning", "Invalid argument for lazyfree_max_pending");
+                return REDISMODULE_ERR;
+            }
+            g_expire_algorithm.lazyfree_max_pending = v;
+        } else if (!mstrcasecmp(argv[ii], "expire_granularity")) {
+            long long v;
+            if (RedisModule_StringToLongLong(argv[ii + 1], &v) == REDISMODULE_ERR || v < 1) {
+                RedisModule_Log(ctx, "warning", "Invalid argument for expire_granularity");
+                return REDISMODULE_ERR;
+            }
+            g_expire_algorithm.expire_granularity = v;
+        } else if (!mstrcasecmp(argv[ii], "memory_pressure_ratio")) {
+            long long v;
+            if (RedisModule_StringToLongLong(argv[ii + 1], &v) == REDISMODULE_ERR || v < 0 || v > 99) {
+                RedisModule_Log(ctx, "warning", "Invalid argument for memory_pressure_ratio");
+                return REDISMODULE_ERR;
+            }
+            g_expire_algorithm.memory_pressure_ratio = v;
+        } else if (!mstrcasecmp(argv[ii], "chunked_read_threshold")) {
+            long long v;
+            if (RedisModule_StringToLongLong(argv[ii + 1], &v) == REDISMODULE_ERR || v < 0) {
+                RedisModule_Log(ctx, "warning", "Invalid argument for chunked_read_threshold");
+                return REDISMODULE_ERR;
+            }
+            g_expire_algorithm.chunked_read_threshold = v;
+        } else if (!mstrcasecmp(argv[ii], "chunked_read_fields_per_loop")) {
+            long long v;
+            if (RedisModule_StringToLongLong(argv[ii + 1], &v) == REDISMODULE_ERR || v < 1) {
+                RedisModule_Log(ctx, "warning", "Invalid argument for chunked_read_fields_per_loop");
+                return REDISMODULE_ERR;
+            }
+            g_expire_algorithm.chunked_read_fields_per_loop = v;
+        } else if (!mstrcasecmp(argv[ii], "index_thread")) {
+            long long v;
+            if (RedisModule_StringToLongLong(argv[ii + 1], &v) == REDISMODULE_ERR) {
+                RedisModule_Log(ctx, "warning", "Invalid argument for index_thread");
+                return REDISMODULE_ERR;
+            }
+#if !defined(SORT_MODE)
+            if (v) {
+                RedisModule_Log(ctx, "warning", "index_thread is only supported in SORT_MODE");
+                return REDISMODULE_ERR;
+            }
+#endif
+            g_expire_algorithm.index_thread = v != 0;
         } else {
             RedisModule_Log(ctx, "warning", "Unrecognized option");
             return REDISMODULE_ERR;
@@ -3109,7 +4715,7 @@ int __attribute__((visibility("default"))) RedisModule_OnLoad(RedisModuleCtx *ct
         .aof_rewrite = TairHashTypeAofRewrite,
         .free = TairHashTypeFree,
         .digest = TairHashTypeDigest,
-#if defined(SORT_MODE) || defined(SLAB_MODE)
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
         .unlink2 = TairHashTypeUnlink2,
         .copy2 = TairHashTypeCopy2,
         .free_effort2 = TairHashTypeEffort2,
@@ -3128,8 +4734,9 @@ int __attribute__((visibility("default"))) RedisModule_OnLoad(RedisModuleCtx *ct
         return REDISMODULE_ERR;
     }
 
-#if defined(SORT_MODE) || defined(SLAB_MODE)
-    for (int i = 0; i < DB_NUM; i++) {
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
+    g_expire_index = RedisModule_Alloc(g_expire_algorithm.db_num * sizeof(m_zskiplist *));
+    for (int i = 0; i < g_expire_algorithm.db_num; i++) {
         g_expire_index[i] = m_zslCreate();
     }
 
@@ -3143,12 +4750,30 @@ int __attribute__((visibility("default"))) RedisModule_OnLoad(RedisModuleCtx *ct
     slab_initShuffleMask();
 #endif
 
+    updateMemoryPressure();
+
+    if (g_expire_algorithm.lazyfree_threshold && lazyfreeInit() != REDISMODULE_OK) {
+        RedisModule_Log(ctx, "warning", "Can not create the lazyfree thread");
+        return REDISMODULE_ERR;
+    }
+
+    if (g_expire_algorithm.index_thread && indexThreadInit() != REDISMODULE_OK) {
+        RedisModule_Log(ctx, "warning", "Can not create the index thread");
+        return REDISMODULE_ERR;
+    }
+
     g_expire_algorithm.insert = insert;
     g_expire_algorithm.update = update;
     g_expire_algorithm.delete = delete;
     g_expire_algorithm.deleteAndPropagate = deleteAndPropagate;
     g_expire_algorithm.activeExpire = activeExpire;
     g_expire_algorithm.passiveExpire = passiveExpire;
+    g_expire_algorithm.rangeByExpire = rangeByExpire;
+    g_expire_algorithm.countExpired = countExpired;
+    g_expire_algorithm.maxExpire = maxExpire;
+#if defined(BTREE_MODE)
+    g_expire_algorithm.bulkInsert = bulkInsert;
+#endif
 
     if (g_expire_algorithm.enable_active_expire) {
         /* Here we can't directly use the 'ctx' passed by OnLoad, because
@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 
+#include "btree.h"
 #include "dict.h"
 #include "list.h"
 #include "redismodule.h"
@@ -45,16 +46,41 @@
 #define TAIR_HASH_SET_WITH_GT_VER (1 << 7)
 #define TAIR_HASH_SET_WITH_BOUNDARY (1 << 8)
 #define TAIR_HASH_SET_KEEPTTL (1 << 9)
+#define TAIR_HASH_SET_GET (1 << 10)
+
+#define TAIR_HASH_SCAN_NOVALUES (1 << 0)
+#define TAIR_HASH_SCAN_WITHTTL (1 << 1)
+#define TAIR_HASH_SCAN_WITHVER (1 << 2)
+#define TAIR_HASH_SCAN_NOTTL (1 << 3)
+#define TAIR_HASH_SCAN_TTLBELOW (1 << 4)
+#define TAIR_HASH_SCAN_TTLABOVE (1 << 5)
+
+#define TAIR_HASH_READ_KEYS (1 << 0)
+#define TAIR_HASH_READ_VALUES (1 << 1)
+#define TAIR_HASH_READ_VERSIONS (1 << 2)
+
+#define TAIR_HASH_AGG_SUM 0
+#define TAIR_HASH_AGG_MIN 1
+#define TAIR_HASH_AGG_MAX 2
+#define TAIR_HASH_AGG_COUNT 3
 
 #define UNIT_SECONDS 0
 #define UNIT_MILLISECONDS 1
-#define DB_NUM 16 /* This value must be equal to the db_dum of redis. */
+#define TAIR_HASH_DEFAULT_DB_NUM 16 /* Used only when `CONFIG GET databases` fails. */
 
 #define TAIR_HASH_ACTIVE_EXPIRE_PERIOD 1000
 #define TAIR_HASH_ACTIVE_EXPIRE_KEYS_PER_LOOP 1000
 #define TAIR_HASH_ACTIVE_DBS_PER_CALL 16
 #define TAIR_HASH_PASSIVE_EXPIRE_KEYS_PER_LOOP 3
 #define TAIR_HASH_SCAN_DEFAULT_COUNT 10
+#define TAIR_HASH_LAZYFREE_THRESHOLD (64 * 1024)
+#define TAIR_HASH_LAZYFREE_MAX_PENDING 10000
+#define TAIR_HASH_EXPIRE_GRANULARITY 1
+#define TAIR_HASH_MEMORY_PRESSURE_RATIO 70 /* Percent of maxmemory. */
+#define TAIR_HASH_MEMORY_PRESSURE_MAX_LEVEL 3
+#define TAIR_HASH_CHUNKED_READ_THRESHOLD 0 /* Fields, disabled by default, see chunkedReadIfNeeded(). */
+#define TAIR_HASH_CHUNKED_READ_FIELDS_PER_LOOP 10000
+#define TAIR_HASH_WINCR_MAX_BUCKETS 1024 /* Buckets of an EXHWINCR window. */
 
 #define Module_Assert(_e) ((_e) ? (void)0 : (_moduleAssert(#_e, __FILE__, __LINE__), abort()))
 
@@ -75,10 +101,24 @@ typedef struct tairHashObj {
     dict *hash;
 #if defined SLAB_MODE
     tairhash_zskiplist *expire_index;
+#elif defined BTREE_MODE
+    m_btree *expire_index;
 #else
     m_zskiplist *expire_index;
 #endif
     RedisModuleString *key;
+    /* Unique per object, tells a key that has been deleted and created again apart from
+     * the original one even when the allocator hands out the same address. */
+    uint64_t generation;
+    /* Number of fields with an expire and an upper bound of their expires, when all the
+     * fields have an expire and `max_expire` has passed, the whole key can be dropped. */
+    unsigned long expire_fields;
+    long long max_expire;
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
+    /* Score of this key in the global expire index, 0 if it is not indexed. It is only
+     * a lower bound of the earliest field expire, see globalExpireIndexUpdate(). */
+    long long global_expire_score;
+#endif
 } tairHashObj;
 
 typedef struct ExpireAlgorithm {
@@ -88,22 +128,68 @@ typedef struct ExpireAlgorithm {
     void (*deleteAndPropagate)(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *obj, RedisModuleString *field, long long expire, int is_timer);
     void (*activeExpire)(RedisModuleCtx *ctx, int dbid, uint64_t keys);
     void (*passiveExpire)(RedisModuleCtx *ctx, int dbid, RedisModuleString *key_per_loop);
+    /* Optional, index `n` expire fields of a new key at once (rdb load and copy). */
+    void (*bulkInsert)(int dbid, tairHashObj *obj, long long *expires, RedisModuleString **fields, size_t n);
+    /* Fields of `obj` with an expire in [min, max] in expire order walking the expire index,
+     * at most `limit` of them. Returns how many were stored in `expires` and `fields`. */
+    size_t (*rangeByExpire)(tairHashObj *obj, long long min, long long max, long long *expires, RedisModuleString **fields, size_t limit);
+    /* Number of fields of `obj` that have expired before `now` but are still in the hash,
+     * the expire index is walked from its head. */
+    unsigned long (*countExpired)(tairHashObj *obj, long long now);
+    /* Upper bound of the expires in the expire index of `obj`, read from its tail. It is
+     * called once the entry of `cur_expire` has been removed or moved in the index. */
+    long long (*maxExpire)(tairHashObj *obj, long long cur_expire);
+
+    /* Number of redis databases, read from the server at load time. */
+    int db_num;
 
     int enable_active_expire;
     uint64_t active_expire_period;
     uint64_t dbs_per_active_loop;
     uint64_t keys_per_active_loop;
     uint64_t keys_per_passive_loop;
-    uint64_t stat_active_expired_field[DB_NUM];
-    uint64_t stat_passive_expired_field[DB_NUM];
+    uint64_t lazyfree_threshold;
+    uint64_t lazyfree_max_pending;
+    uint64_t expire_granularity;
+    /* EXHKEYS/EXHVALS/EXHGETALL on keys with at least `chunked_read_threshold` fields
+     * block the client and read `chunked_read_fields_per_loop` fields per event loop. */
+    uint64_t chunked_read_threshold;
+    uint64_t chunked_read_fields_per_loop;
+    /* Field expire indexes are maintained by a background thread, SORT_MODE only. */
+    int index_thread;
+    /* When used memory goes above `memory_pressure_ratio` percent of maxmemory, the
+     * effective quotas are scaled by 2^memory_pressure_level, see updateMemoryPressure(). */
+    uint64_t memory_pressure_ratio;
+    int memory_pressure_level;
+    uint64_t effective_active_expire_period;
+    uint64_t effective_keys_per_active_loop;
+    uint64_t effective_keys_per_passive_loop;
+    uint64_t *stat_active_expired_field;
+    uint64_t *stat_passive_expired_field;
+    uint64_t stat_whole_key_expired;
     uint64_t stat_last_active_expire_time_msec;
     uint64_t stat_avg_active_expire_time_msec;
     uint64_t stat_max_active_expire_time_msec;
 } ExpireAlgorithm;
 
 void _moduleAssert(const char *estr, const char *file, int line);
+void tairHashValRelease(struct TairHashVal *o);
+int tairHashDeleteField(RedisModuleCtx *ctx, tairHashObj *o, RedisModuleString *field);
 RedisModuleString *takeAndRef(RedisModuleString *str);
+int canPropagateInTimer(void);
+void updateMemoryPressure(void);
+#if defined(SORT_MODE) || defined(SLAB_MODE) || defined(BTREE_MODE)
+void globalExpireIndexUpdate(int dbid, tairHashObj *o, long long min_expire);
+void globalExpireIndexDelete(int dbid, tairHashObj *o);
+#endif
 int delEmptyTairHashIfNeeded(RedisModuleCtx *ctx, RedisModuleKey *key, RedisModuleString *raw_key, tairHashObj *obj);
+int keyExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleKey *key, RedisModuleString *raw_key, tairHashObj *obj, int is_active);
+void expireFieldAdded(tairHashObj *obj, long long expire);
+void expireFieldUpdated(tairHashObj *obj, long long cur_expire, long long new_expire);
+void expireFieldRemoved(tairHashObj *obj, long long cur_expire);
 void notifyFieldSpaceEvent(char *event, RedisModuleString *key, RedisModuleString *field, int dbid);
 int isExpire(long long when);
+int isReadOnlyStatus(RedisModuleCtx *ctx);
+int fieldEntryExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, m_dictEntry *de, int is_timer);
 int fieldExpireIfNeeded(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field, int is_timer);
+m_dictEntry *lookupField(RedisModuleCtx *ctx, int dbid, RedisModuleString *key, tairHashObj *o, RedisModuleString *field);
@@ -121,6 +121,36 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal val2 $ret_val
     }
 
+    test {Exhset GET / exhgetdel / exhgetex} {
+        r del tairhashkey
+
+        assert_equal {} [r exhset tairhashkey field val1 get]
+        assert_equal val1 [r exhset tairhashkey field val2 get]
+        assert_equal val2 [r exhset tairhashkey field val3 nx get]
+        assert_equal {} [r exhset tairhashkey field_xx val xx get]
+        assert_equal val2 [r exhget tairhashkey field]
+        assert_equal 0 [r exhexists tairhashkey field_xx]
+
+        assert_equal val2 [r exhgetex tairhashkey field px 100000]
+        assert {[r exhpttl tairhashkey field] > 0}
+        assert_equal 3 [r exhver tairhashkey field]
+        assert_equal val2 [r exhgetex tairhashkey field persist]
+        assert_equal -1 [r exhpttl tairhashkey field]
+        assert_equal {} [r exhgetex tairhashkey field_not_exist ex 10]
+        catch {r exhgetex tairhashkey field ex 10 persist} err
+        assert_match {*ERR*syntax*error*} $err
+
+        assert_equal val2 [r exhgetdel tairhashkey field]
+        assert_equal {} [r exhgetdel tairhashkey field]
+        assert_equal 0 [r exists tairhashkey]
+
+        r exhset tairhashkey field val px 100
+        r exhset tairhashkey field2 val
+        after 200
+        assert_equal {} [r exhgetdel tairhashkey field]
+        assert_equal 1 [r exhlen tairhashkey]
+    }
+
     test {Exhset/exhget EX/EXAT/PX/PXAT with active expire } {
         r del tairhashkey
 
@@ -683,6 +713,29 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal 3 $h_len
     }
 
+    test {Exhlen noexp} {
+        r del tairhashkey
+
+        assert_equal 0 [r exhlen tairhashkey noexp]
+        for {set j 0} {$j < 100} {incr j} {
+            r exhset tairhashkey short$j val px 100
+            r exhset tairhashkey long$j val px 100000
+        }
+        r exhset tairhashkey noexpire val
+        assert_equal 201 [r exhlen tairhashkey noexp]
+
+        after 200
+        assert_equal 101 [r exhlen tairhashkey noexp]
+
+        r exhpersist tairhashkey long0
+        r exhdel tairhashkey long1
+        assert_equal 100 [r exhlen tairhashkey noexp]
+
+        r exhset tairhashkey long2 val px 1
+        after 10
+        assert_equal 99 [r exhlen tairhashkey noexp]
+    }
+
     test {Exhdelwithver} {
         r del tairhashkey
 
@@ -698,6 +751,19 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal 2 $del_num
 
         assert_equal 1 [r exhexists tairhashkey field3]
+
+        # A field kept because of its version stays indexed.
+        for {set j 0} {$j < 100} {incr j} {
+            r exhset tairhashkey f:$j val px 1000
+        }
+        for {set j 0} {$j < 100} {incr j} {
+            assert_equal 0 [r exhdelwithver tairhashkey f:$j 2]
+        }
+        assert_equal {val val} [r exhmget tairhashkey f:0 f:99]
+        assert_equal 100 [llength [r exhrangebyttl tairhashkey 0 1000]]
+        after 1100
+        assert_equal 1 [r exhlen tairhashkey noexp]
+        assert_equal 1 [r exhdel tairhashkey field3 f:0]
     }
 
     test {Exhexists} {
@@ -796,6 +862,63 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal -5 [r exhincrby tairhashkey f1 -8 min -5 max 10]
     }
 
+    test {Exhmincrby} {
+        r del tairhashkey
+
+        catch {r exhmincrby tairhashkey fields 1 f1} e
+        assert_match {*ERR*syntax*error*} $e
+
+        catch {r exhmincrby tairhashkey fields 1 f1 xxx} e
+        assert_match {ERR*not an integer*} $e
+
+        assert_equal {1 2 4} [r exhmincrby tairhashkey fields 3 f1 1 f2 2 f1 3]
+        assert_equal 4 [r exhget tairhashkey f1]
+        assert_equal 2 [r exhver tairhashkey f1]
+        assert_equal 2 [r exhget tairhashkey f2]
+
+        r exhset tairhashkey f3 abc
+        catch {r exhmincrby tairhashkey fields 2 f1 1 f3 1} e
+        assert_match {ERR*not an integer*} $e
+        assert_equal 4 [r exhget tairhashkey f1]
+
+        catch {r exhmincrby tairhashkey max 5 fields 2 f1 1 f2 4} e
+        assert_match {ERR*increment or decrement would overflow*} $e
+        assert_equal 4 [r exhget tairhashkey f1]
+        assert_equal 2 [r exhget tairhashkey f2]
+        assert_equal 0 [r exhexists tairhashkey f4]
+
+        assert_equal {5 -1} [r exhmincrby tairhashkey ex 10 min -1 max 5 fields 2 f1 1 f4 -1]
+        assert_range [r exhttl tairhashkey f1] 1 10
+        assert_range [r exhttl tairhashkey f4] 1 10
+        assert_equal {3} [r exhmincrby tairhashkey keepttl fields 1 f1 -2]
+        assert_range [r exhttl tairhashkey f1] 1 10
+        assert_equal {4} [r exhmincrby tairhashkey fields 1 f1 1]
+        assert_equal -1 [r exhttl tairhashkey f1]
+    }
+
+    test {Exhwincr} {
+        r del tairhashkey
+
+        assert_equal 0 [r exhwincr tairhashkey req 1000 10 0]
+        assert_equal 0 [r exists tairhashkey]
+        assert_equal 1 [r exhwincr tairhashkey req 1000 10 1]
+        assert_equal 3 [r exhwincr tairhashkey req 1000 10 2]
+        assert_equal 1 [r exhwincr tairhashkey other 1000 10 1]
+        assert_equal 3 [r exhwincr tairhashkey req 1000 10 0]
+        assert {[r exhlen tairhashkey] >= 2}
+
+        after 1200
+        assert_equal 0 [r exhwincr tairhashkey req 1000 10 0]
+        assert_equal -1 [r exhwincr tairhashkey req 1000 10 -1]
+
+        catch {r exhwincr tairhashkey req 1000 0 1} err
+        assert_match {*ERR*syntax*} $err
+        catch {r exhwincr tairhashkey req 5 10 1} err
+        assert_match {*ERR*syntax*} $err
+        catch {r exhwincr tairhashkey req 1000 10 a} err
+        assert_match {*ERR*not*integer*} $err
+    }
+
     test {Exhincrbyfloat} {
         r del tairhashkey
 
@@ -1137,6 +1260,21 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal 0 $ret_val
     }
 
+    test {Exhmget many fields} {
+        r del tairhashkey
+        set args {}
+        set expected {}
+        for {set i 0} {$i < 40} {incr i} {
+            assert_equal 1 [r exhset tairhashkey field$i val$i]
+            lappend args field$i field-not-exist$i
+            lappend expected val$i {}
+        }
+        assert_equal 1 [r exhset tairhashkey expired val PX 50]
+        after 100
+        set result [r exhmget tairhashkey {*}$args expired field0 expired]
+        assert_equal $result [concat $expected {{} val0 {}}]
+    }
+
     test {Exhsetnx} {
         r del tairhashkey
 
@@ -1159,6 +1297,64 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal $result {val1 val2 {}}
     }
 
+    test {Exhmsetex} {
+        r del tairhashkey
+
+        catch {r exhmsetex tairhashkey EX 10 FIELDS 2 field1 val1} err
+        assert_match {*ERR*syntax*} $err
+        catch {r exhmsetex tairhashkey EX 10 KEEPTTL FIELDS 1 field1 val1} err
+        assert_match {*ERR*syntax*} $err
+
+        assert_equal 0 [r exhmsetex tairhashkey XX FIELDS 1 field1 val1]
+        assert_equal 0 [r exists tairhashkey]
+
+        assert_equal 1 [r exhmsetex tairhashkey NX PX 100 FIELDS 2 field1 val1 field2 val2]
+        assert_equal {val1 val2} [r exhmget tairhashkey field1 field2]
+        assert_equal 0 [r exhmsetex tairhashkey NX FIELDS 2 field2 val2 field3 val3]
+
+        assert_equal 1 [r exhmsetex tairhashkey XX KEEPTTL FIELDS 2 field1 new1 field2 new2]
+        assert_equal {new1 new2} [r exhmget tairhashkey field1 field2]
+        assert_equal 2 [r exhver tairhashkey field1]
+        assert {[r exhpttl tairhashkey field1] > 0}
+
+        assert_equal 1 [r exhmsetex tairhashkey FIELDS 2 field1 val1 field3 val3]
+        assert_equal -1 [r exhttl tairhashkey field1]
+
+        after 200
+        assert_equal {val1 {} val3} [r exhmget tairhashkey field1 field2 field3]
+    }
+
+    test {Exhmsetex VER/ABS/GT} {
+        r del tairhashkey
+
+        catch {r exhmsetex tairhashkey VER 1 ABS 2 FIELDS 1 field1 val1} err
+        assert_match {*ERR*syntax*} $err
+        catch {r exhmsetex tairhashkey ABS 0 FIELDS 1 field1 val1} err
+        assert_match {*ERR*syntax*} $err
+        catch {r exhmsetex tairhashkey GT -1 FIELDS 1 field1 val1} err
+        assert_match {*ERR*syntax*} $err
+
+        assert_equal 1 [r exhmsetex tairhashkey ABS 5 FIELDS 2 field1 val1 field2 val2]
+        assert_equal 5 [r exhver tairhashkey field1]
+        assert_equal 5 [r exhver tairhashkey field2]
+
+        r exhset tairhashkey field2 val2
+        catch {r exhmsetex tairhashkey VER 5 FIELDS 2 field1 new1 field2 new2} err
+        assert_match {*ERR*update version is stale*} $err
+        assert_equal {val1 val2} [r exhmget tairhashkey field1 field2]
+        assert_equal 1 [r exhmsetex tairhashkey VER 0 FIELDS 2 field1 new1 field2 new2]
+        assert_equal 6 [r exhver tairhashkey field1]
+        assert_equal 7 [r exhver tairhashkey field2]
+
+        catch {r exhmsetex tairhashkey GT 7 FIELDS 1 field2 val2} err
+        assert_match {*ERR*update version is stale*} $err
+        assert_equal 1 [r exhmsetex tairhashkey GT 8 FIELDS 2 field2 val2 field3 val3]
+        assert_equal 8 [r exhver tairhashkey field2]
+        assert_equal 8 [r exhver tairhashkey field3]
+        assert_equal 1 [r exhmsetex tairhashkey VER 8 FIELDS 1 field3 new3]
+        assert_equal 9 [r exhver tairhashkey field3]
+    }
+
     test {Exhver} {
         r del tairhashkey
 
@@ -1440,6 +1636,45 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal 0 $res "assert fail, tairhash still exist"
     }
 
+    test {Whole key expired when all fields expired} {
+        r select 9
+        r del tairhashkey
+
+        for {set i 0} {$i < 10} {incr i} {
+            assert_equal 1 [r exhset tairhashkey field$i val EX 1]
+        }
+        assert_equal 1 [r exhset tairhashkey persist val]
+        assert_equal 1 [r exhdel tairhashkey persist]
+
+        after 3000
+
+        assert_equal 0 [r exists tairhashkey]
+        set info [r exhexpireinfo]
+        assert { [string match "*db: 9, active_expired_fields: 10*" $info] }
+        assert { [regexp {tair_hash_whole_key_expired_keys:([0-9]+)} $info -> whole_keys] }
+        assert { $whole_keys >= 1 }
+    }
+
+    test {Whole key expired after the latest expire is deleted or lowered} {
+        r select 9
+        r del tairhashkey
+        assert { [regexp {tair_hash_whole_key_expired_keys:([0-9]+)} [r exhexpireinfo] -> before] }
+
+        for {set i 0} {$i < 10} {incr i} {
+            assert_equal 1 [r exhset tairhashkey field$i val EX 1]
+        }
+        assert_equal 1 [r exhset tairhashkey deleted val EX 1000]
+        assert_equal 1 [r exhset tairhashkey lowered val EX 1000]
+        assert_equal 1 [r exhdel tairhashkey deleted]
+        assert_equal 1 [r exhexpire tairhashkey lowered 1]
+
+        after 3000
+
+        assert_equal 0 [r exists tairhashkey]
+        assert { [regexp {tair_hash_whole_key_expired_keys:([0-9]+)} [r exhexpireinfo] -> after] }
+        assert { $after > $before }
+    }
+
     test {Exhpersist} {
         r del tairhashkey
 
@@ -1479,6 +1714,33 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         assert_equal $result {{} {} {}}
     }
 
+    test {Exhmgetm} {
+        r del tairhashkey tairhashkey2
+
+        assert_equal 1 [r exhset tairhashkey field1 val1]
+        assert_equal 1 [r exhset tairhashkey field2 val2]
+        assert_equal 1 [r exhset tairhashkey2 field1 val3]
+
+        set result [r exhmgetm tairhashkey 3 field1 field2 field-not-exist tairhashkey2 1 field1 tairhashkey-not-exist 1 field1]
+        assert_equal $result {{val1 val2 {}} val3 {{}}}
+
+        assert_equal 1 [r exhset tairhashkey field3 val4 px 100]
+        after 200
+        assert_equal {{{}}} [r exhmgetm tairhashkey 1 field3]
+
+        catch {r exhmgetm tairhashkey 2 field1} err
+        assert_match {*ERR*syntax*} $err
+        catch {r exhmgetm tairhashkey 0 tairhashkey2 1 field1} err
+        assert_match {*ERR*syntax*} $err
+
+        r set stringkey foo
+        catch {r exhmgetm tairhashkey 1 field1 stringkey 1 field1} err
+        assert_match {*WRONGTYPE*} $err
+        r del tairhashkey tairhashkey2 stringkey
+
+        assert_equal {tairhashkey field1} [r command getkeys exhmgetm tairhashkey 2 field1 field2 field1 1 field3]
+    }
+
     test {Exhmsetwithopts} {
         r del tairhashkey
 
@@ -1583,6 +1845,92 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
         lsort -unique [lindex $res 1]
     } {1 10 foo foobar}
 
+    test "EXHSCAN with options" {
+        r del tairhashkey
+        r exhset tairhashkey f1 v1
+        r exhset tairhashkey f2 v2 ex 100
+        r exhset tairhashkey f3 v3 px 2000
+        r exhset tairhashkey f4 v4 px 100
+        after 200
+
+        set res [r exhscan tairhashkey 0 COUNT 10000 NOVALUES]
+        assert_equal {f1 f2 f3} [lsort [lindex $res 1]]
+
+        set res [r exhscan tairhashkey 0 COUNT 10000 NOTTL WITHTTL WITHVER]
+        assert_equal {f1 v1 -1 1} [lindex $res 1]
+
+        set res [r exhscan tairhashkey 0 COUNT 10000 NOVALUES TTLBELOW 10000]
+        assert_equal {f3} [lindex $res 1]
+
+        set res [r exhscan tairhashkey 0 COUNT 10000 NOVALUES TTLABOVE 10000 WITHTTL]
+        assert_equal f2 [lindex [lindex $res 1] 0]
+        assert_range [lindex [lindex $res 1] 1] 10001 100000
+
+        set res [r exhscan tairhashkey 0 COUNT 10000 NOVALUES TTLABOVE 1000 TTLBELOW 10000]
+        assert_equal {f3} [lindex $res 1]
+
+        catch {r exhscan tairhashkey 0 NOTTL TTLBELOW 10} e
+        assert_match {*ERR*syntax*error*} $e
+        catch {r exhscan tairhashkey 0 TTLABOVE xxx} e
+        assert_match {*ERR*syntax*error*} $e
+    }
+
+    test "EXHRANGEBYTTL" {
+        r del tairhashkey
+        assert_equal {} [r exhrangebyttl tairhashkey 0 1000]
+
+        r exhset tairhashkey f1 v1 px 5000
+        r exhset tairhashkey f2 v2 px 60000
+        r exhset tairhashkey f3 v3 px 20000
+        r exhset tairhashkey f4 v4
+        r exhset tairhashkey f5 v5 px 100
+        after 200
+
+        assert_equal {f1 f3 f2} [r exhrangebyttl tairhashkey 0 100000]
+        assert_equal {f1 v1 f3 v3} [r exhrangebyttl tairhashkey 0 30000 WITHVALUES]
+        assert_equal {f3 f2} [r exhrangebyttl tairhashkey 10000 100000]
+        assert_equal {f3} [r exhrangebyttl tairhashkey 0 100000 LIMIT 1 1]
+        assert_equal {f3 f2} [r exhrangebyttl tairhashkey 0 100000 LIMIT 1 -1]
+        assert_equal {} [r exhrangebyttl tairhashkey 0 100000 LIMIT 3 10]
+        assert_equal {} [r exhrangebyttl tairhashkey 100000 0]
+
+        catch {r exhrangebyttl tairhashkey -1 100} e
+        assert_match {*ERR*syntax*error*} $e
+        catch {r exhrangebyttl tairhashkey 0 100 LIMIT 0} e
+        assert_match {*ERR*syntax*error*} $e
+    }
+
+    test "EXHAGG" {
+        r del tairhashkey
+        assert_equal 0 [r exhagg tairhashkey sum]
+        assert_equal {} [r exhagg tairhashkey min]
+        assert_equal 0 [r exhagg tairhashkey count]
+
+        r exhmset tairhashkey c:1 10 c:2 2.5 c:3 foo c:4 -4 other 100
+        r exhset tairhashkey c:5 1000 px 100
+        after 200
+
+        assert_equal 108.5 [r exhagg tairhashkey sum]
+        assert_equal 8.5 [r exhagg tairhashkey sum match c:*]
+        assert_equal -4 [r exhagg tairhashkey min]
+        assert_equal 100 [r exhagg tairhashkey max]
+        assert_equal 10 [r exhagg tairhashkey max match c:*]
+        assert_equal 4 [r exhagg tairhashkey count]
+        assert_equal 0 [r exhagg tairhashkey count match x*]
+        assert_equal {} [r exhagg tairhashkey max match x*]
+
+        r exhmset tairhashkey c:6 inf c:7 -inf c:8 nan
+        assert_equal 108.5 [r exhagg tairhashkey sum]
+        assert_equal -4 [r exhagg tairhashkey min]
+        assert_equal 100 [r exhagg tairhashkey max]
+        assert_equal 4 [r exhagg tairhashkey count]
+
+        catch {r exhagg tairhashkey avg} e
+        assert_match {*ERR*syntax*error*} $e
+        catch {r exhagg tairhashkey sum count c:*} e
+        assert_match {*ERR*syntax*error*} $e
+    }
+
      test {Exhset keepttl} {
         r del exhashkey
 
@@ -1804,6 +2152,20 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
                 assert_equal 1 [$slave exhexists tairhashkey field]
             }
 
+            test {Exhset keepttl master-slave} {
+                $master del tairhashkey
+
+                assert_equal 1 [$master exhset tairhashkey field val EX 100]
+                assert_equal 0 [$master exhset tairhashkey field val2 KEEPTTL]
+                assert_equal 0 [$master exhset tairhashkey field val3 ABS 5 KEEPTTL]
+                $master WAIT 1 5000
+
+                set slave_ttl [$slave exhttl tairhashkey field]
+                assert {$slave_ttl <= 100 && $slave_ttl >= 90}
+                assert_equal val3 [$slave exhget tairhashkey field]
+                assert_equal 5 [$slave exhver tairhashkey field]
+            }
+
             test {Exhsetver master-slave} {
                 $master del tairhashkey
 
@@ -1955,6 +2317,86 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
                 assert_equal $incr_val $val
             }
 
+            test {Exhmsetex XX/NX master-slave} {
+                $master del tairhashkey
+
+                assert_equal 1 [$master exhmsetex tairhashkey px 100000 fields 2 f1 v1 f2 v2]
+                assert_equal 1 [$master exhmsetex tairhashkey xx keepttl fields 2 f1 v3 f2 v4]
+                assert_equal 0 [$master exhmsetex tairhashkey xx fields 2 f1 v5 f3 v6]
+                assert_equal 1 [$master exhmsetex tairhashkey nx exat 4102444800 fields 1 f4 v7]
+
+                $master WAIT 1 5000
+
+                assert_equal {v3 v4 {} v7} [$slave exhmget tairhashkey f1 f2 f3 f4]
+                assert {[$slave exhpttl tairhashkey f1] > 0}
+                assert {abs([$master exhpttl tairhashkey f4] - [$slave exhpttl tairhashkey f4]) < 1000}
+                assert_equal [$master exhver tairhashkey f1] [$slave exhver tairhashkey f1]
+
+                assert_equal 1 [$master exhmsetex tairhashkey gt 10 fields 2 f1 v8 f5 v9]
+                assert_equal 1 [$master exhmsetex tairhashkey ver 10 fields 1 f5 v10]
+
+                $master WAIT 1 5000
+
+                assert_equal {v8 v10} [$slave exhmget tairhashkey f1 f5]
+                assert_equal 10 [$slave exhver tairhashkey f1]
+                assert_equal 11 [$slave exhver tairhashkey f5]
+            }
+
+            test {Exhmincrby master-slave} {
+                $master del tairhashkey
+
+                assert_equal {1 2 3} [$master exhmincrby tairhashkey px 100000 fields 3 f1 1 f2 2 f1 2]
+
+                $master WAIT 1 5000
+
+                assert_equal 3 [$slave exhget tairhashkey f1]
+                assert_equal 2 [$slave exhget tairhashkey f2]
+                assert_equal [$master exhver tairhashkey f1] [$slave exhver tairhashkey f1]
+                assert {[$slave exhpttl tairhashkey f1] > 0}
+            }
+
+            test {Exhgetdel / exhgetex master-slave} {
+                $master del tairhashkey
+
+                $master exhset tairhashkey f1 v1
+                $master exhset tairhashkey f2 v2
+                assert_equal v1 [$master exhgetdel tairhashkey f1]
+                assert_equal v2 [$master exhgetex tairhashkey f2 px 100000]
+
+                $master WAIT 1 5000
+
+                assert_equal 0 [$slave exhexists tairhashkey f1]
+                assert_equal [$master exhver tairhashkey f2] [$slave exhver tairhashkey f2]
+                assert {[$slave exhpttl tairhashkey f2] > 0}
+            }
+
+            test {Exhwincr master-slave} {
+                $master del tairhashkey
+
+                assert_equal 5 [$master exhwincr tairhashkey req 100000 10 5]
+
+                $master WAIT 1 5000
+
+                assert_equal [$master exhkeys tairhashkey] [$slave exhkeys tairhashkey]
+                assert_equal 5 [$slave exhvals tairhashkey]
+                assert {[$slave exhpttl tairhashkey [$slave exhkeys tairhashkey]] > 0}
+            }
+
+            test {Exhwincr on a writable replica with an expired bucket} {
+                $slave config set replica-read-only no
+                $slave del tairhashkey
+
+                # One bucket of 10^8 ms, its number comes from the server time.
+                set now [$slave time]
+                set bucket [expr {([lindex $now 0] * 1000 + [lindex $now 1] / 1000) / 100000000}]
+                $slave exhset tairhashkey req:$bucket 10 px 1
+                after 10
+                assert_equal 2 [$slave exhwincr tairhashkey req 100000000 1 2]
+
+                $slave del tairhashkey
+                $slave config set replica-read-only yes
+            }
+
             test {Exhincrbyfloat master-slave} {
                 $master del tairhashkey
 
@@ -2083,4 +2525,523 @@ start_server {tags {"tairhash"} overrides {bind 0.0.0.0}} {
             # }
         }
     }
-}
\ No newline at end of file
+}
+start_server {tags {"tairhash chunked read"} overrides {bind 0.0.0.0}} {
+    r module load $testmodule chunked_read_threshold 100 chunked_read_fields_per_loop 10
+
+    test {Exhgetall chunked read} {
+        r del tairhashkey
+        set elements {}
+        for {set j 0} {$j < 1000} {incr j} {
+            lappend elements key:$j $j
+        }
+        r exhmset tairhashkey {*}$elements
+        r exhset tairhashkey expired v px 1
+        after 10
+
+        set res [r exhgetall tairhashkey]
+        assert_equal 2000 [llength $res]
+        foreach {k v} $res {
+            assert {$k eq "key:$v"}
+        }
+        assert_equal 1000 [llength [lsort -unique [r exhkeys tairhashkey]]]
+        assert_equal 1000 [llength [r exhvals tairhashkey]]
+        assert_equal 3000 [llength [r exhgetallwithver tairhashkey]]
+
+        r multi
+        r exhkeys tairhashkey
+        set res [r exec]
+        assert_equal 1000 [llength [lindex $res 0]]
+    }
+
+    test {Exhgetall chunked read ends when the key is deleted and created again} {
+        r del tairhashkey
+        set elements {}
+        for {set j 0} {$j < 50000} {incr j} {
+            lappend elements key:$j $j
+        }
+        r exhmset tairhashkey {*}$elements
+
+        # The new key may reuse the address of the old one, the read must still stop.
+        set rd [redis_deferring_client]
+        $rd exhgetall tairhashkey
+        r del tairhashkey
+        r exhmset tairhashkey key:0 0
+        set res [$rd read]
+        assert {[llength $res] < 100000}
+        foreach {k v} $res {
+            assert {$k eq "key:$v"}
+        }
+        $rd close
+    }
+}
+
+start_server {tags {"tairhash expire granularity"} overrides {bind 0.0.0.0}} {
+    r module load $testmodule expire_granularity 1000
+
+    test {EXHRANGEBYTTL with expire_granularity} {
+        r del tairhashkey
+
+        # Fields of the same one second bucket, set in reverse expire order.
+        r exhset tairhashkey f4 v4 px 60900
+        r exhset tairhashkey f3 v3 px 60600
+        r exhset tairhashkey f2 v2 px 60300
+        r exhset tairhashkey f1 v1 px 60000
+        r exhset tairhashkey other v px 90000
+
+        set res [r exhrangebyttl tairhashkey 0 100000]
+        assert_equal {f1 f2 f3 f4 other} $res
+        assert_equal {f2 f3} [r exhrangebyttl tairhashkey 0 100000 LIMIT 1 2]
+
+        # The window ends inside the bucket, the later fields of the bucket are left out.
+        set res [r exhrangebyttl tairhashkey 0 60450]
+        assert {[lsearch $res f3] == -1 && [lsearch $res f4] == -1 && [lsearch $res other] == -1}
+        assert_equal f1 [lindex $res 0]
+
+        r exhset tairhashkey gone v px 1
+        after 10
+        assert_equal {f1} [r exhrangebyttl tairhashkey 0 100000 LIMIT 0 1]
+    }
+
+    proc server_ms {} {
+        set t [r time]
+        return [expr {[lindex $t 0] * 1000 + [lindex $t 1] / 1000}]
+    }
+
+    test {Active and passive expire with expire_granularity} {
+        r del tairhashkey
+        for {set j 0} {$j < 100} {incr j} {
+            r exhset tairhashkey f$j v px [expr {100 + $j}]
+        }
+        r exhset tairhashkey live v
+        after 300
+
+        # Reads honor the exact expire even when the bucket is not due yet.
+        assert_equal {} [r exhget tairhashkey f0]
+        assert_equal 0 [r exhexists tairhashkey f99]
+        assert_equal 1 [r exhlen tairhashkey noexp]
+
+        # Active expire catches up at most one bucket later.
+        wait_for_condition 50 100 {
+            [r exhlen tairhashkey] == 1
+        } else {
+            fail "fields are not actively expired"
+        }
+    }
+
+    test {EXHLEN NOEXP and EXHRANGEBYTTL inside the bucket of now} {
+        r del tairhashkey
+        r exhset tairhashkey live v
+
+        # Three fields of one bucket ending at `end`, the first expires while the
+        # bucket is the one holding now.
+        set end [expr {([server_ms] / 1000 + 3) * 1000}]
+        r exhset tairhashkey a v pxat [expr {$end - 900}]
+        r exhset tairhashkey b v pxat [expr {$end - 1}]
+        r exhset tairhashkey c v pxat $end
+        assert_equal 4 [r exhlen tairhashkey noexp]
+        assert_equal {a b c} [r exhrangebyttl tairhashkey 0 100000]
+
+        after [expr {$end - 850 - [server_ms]}]
+        assert_equal 3 [r exhlen tairhashkey noexp]
+        assert_equal {b c} [r exhrangebyttl tairhashkey 0 100000]
+        assert_equal {c} [r exhrangebyttl tairhashkey 0 100000 LIMIT 1 1]
+    }
+}
+
+start_server {tags {"tairhash index thread"} overrides {bind 0.0.0.0}} {
+    # The index thread is only built in SORT_MODE, the tests are skipped otherwise.
+    if {![catch {r module load $testmodule index_thread 1}]} {
+        test {Index thread insert/update/delete} {
+            r del tairhashkey
+            r exhset tairhashkey f1 v px 30000
+            r exhset tairhashkey f2 v px 10000
+            r exhset tairhashkey f3 v px 20000
+            r exhset tairhashkey f4 v
+            assert_equal {f2 f3 f1} [r exhrangebyttl tairhashkey 0 100000]
+
+            r exhpexpire tairhashkey f1 5000
+            r exhpersist tairhashkey f2
+            r exhdel tairhashkey f3
+            r exhset tairhashkey f4 v px 50000
+            assert_equal {f1 f4} [r exhrangebyttl tairhashkey 0 100000]
+            assert_equal 4 [r exhlen tairhashkey noexp]
+
+            r exhset tairhashkey f5 v px 1
+            after 10
+            assert_equal 4 [r exhlen tairhashkey noexp]
+            assert_equal {} [r exhget tairhashkey f5]
+        }
+
+        test {Index thread active expire} {
+            r del tairhashkey
+            for {set j 0} {$j < 1000} {incr j} {
+                r exhset tairhashkey f$j v px 100
+            }
+            r exhset tairhashkey live v px 100000
+            wait_for_condition 50 100 {
+                [r exhlen tairhashkey] == 1
+            } else {
+                fail "fields are not actively expired"
+            }
+            assert_equal {live} [r exhrangebyttl tairhashkey 0 100000]
+        }
+
+        test {Index thread FLUSHALL and SWAPDB with queued jobs} {
+            r multi
+            for {set j 0} {$j < 1000} {incr j} {
+                r exhset tairhashkey f$j v px 100000
+            }
+            r flushall
+            r exec
+            assert_equal 0 [r dbsize]
+
+            r select 9
+            r multi
+            for {set j 0} {$j < 1000} {incr j} {
+                r exhset tairhashkey f$j v px [expr {$j < 500 ? 100 : 100000}]
+            }
+            r swapdb 9 10
+            r exec
+            assert_equal 0 [r exists tairhashkey]
+
+            r select 10
+            wait_for_condition 50 100 {
+                [r exhlen tairhashkey] == 500
+            } else {
+                fail "fields are not actively expired after swapdb"
+            }
+            assert_equal 500 [r exhlen tairhashkey noexp]
+            assert_equal 500 [llength [r exhrangebyttl tairhashkey 0 200000]]
+            r flushall
+            r select 9
+            assert_equal PONG [r ping]
+        }
+    }
+}
+
+start_server {tags {"tairhash lazyfree"} overrides {bind 0.0.0.0}} {
+    r module load $testmodule enable_active_expire 0 lazyfree_threshold 1024 lazyfree_max_pending 2
+
+    proc expire_info_field {client field} {
+        regexp "\r\n$field:(\\d+)" [$client exhexpireinfo] -> value
+        return $value
+    }
+
+    proc wait_lazyfree_done {client} {
+        wait_for_condition 50 100 {
+            [expire_info_field $client tair_hash_lazyfree_pending_objects] == 0
+        } else {
+            fail "lazyfree jobs are not done"
+        }
+    }
+
+    test {Lazyfree of deleted and expired big values} {
+        r del tairhashkey
+        set big [string repeat x 100000]
+        set freed [expire_info_field r tair_hash_lazyfree_freed_objects]
+
+        r exhset tairhashkey big1 $big
+        r exhset tairhashkey big2 $big px 10
+        r exhset tairhashkey small v
+        assert_equal 2 [r exhdel tairhashkey big1 small]
+        after 50
+        assert_equal {} [r exhget tairhashkey big2]
+        wait_lazyfree_done r
+        assert_equal [expr {$freed + 2}] [expire_info_field r tair_hash_lazyfree_freed_objects]
+
+        # Overwriting a big value releases it on the spot.
+        r exhset tairhashkey big3 $big
+        r exhset tairhashkey big3 v
+        assert_equal [expr {$freed + 2}] [expire_info_field r tair_hash_lazyfree_freed_objects]
+        assert_equal 1 [r exhstrlen tairhashkey big3]
+    }
+
+    test {Lazyfree releases the memory and applies back-pressure} {
+        r del tairhashkey
+        set big [string repeat x 100000]
+        set fields {}
+        for {set j 0} {$j < 50} {incr j} {
+            r exhset tairhashkey f$j $big
+            lappend fields f$j
+        }
+        r exhset tairhashkey keep v
+        set used [s used_memory]
+        set freed [expire_info_field r tair_hash_lazyfree_freed_objects]
+        set sync_freed [expire_info_field r tair_hash_lazyfree_sync_freed_objects]
+
+        # With lazyfree_max_pending 2 some values may be released synchronously, every
+        # value is released one way or the other.
+        assert_equal 50 [r exhdel tairhashkey {*}$fields]
+        wait_lazyfree_done r
+        set freed [expr {[expire_info_field r tair_hash_lazyfree_freed_objects] - $freed}]
+        set sync_freed [expr {[expire_info_field r tair_hash_lazyfree_sync_freed_objects] - $sync_freed}]
+        assert_equal 50 [expr {$freed + $sync_freed}]
+        assert {[s used_memory] < $used - 4000000}
+    }
+
+    test {Lazyfree is not used inside MULTI} {
+        r del tairhashkey
+        r exhset tairhashkey big [string repeat x 100000]
+        r exhset tairhashkey keep v
+        set freed [expire_info_field r tair_hash_lazyfree_freed_objects]
+
+        r multi
+        r exhdel tairhashkey big
+        r exec
+        assert_equal 0 [expire_info_field r tair_hash_lazyfree_pending_objects]
+        assert_equal $freed [expire_info_field r tair_hash_lazyfree_freed_objects]
+        assert_equal 0 [r exhexists tairhashkey big]
+    }
+
+    start_server {tags {"tairhash lazyfree repl"} overrides {bind 0.0.0.0}} {
+        r module load $testmodule lazyfree_threshold 1024
+        set master [srv 0 client]
+        set master_host [srv 0 host]
+        set master_port [srv 0 port]
+        set slave [srv -1 client]
+
+        $slave slaveof $master_host $master_port
+        wait_for_condition 50 100 {
+            [string match {*master_link_status:up*} [$slave info replication]]
+        } else {
+            fail "Replication not started."
+        }
+
+        test {Lazyfree on a replica of a MULTI falls back to synchronous free} {
+            $master del tairhashkey
+            $master exhset tairhashkey big [string repeat x 100000]
+            $master exhset tairhashkey keep v
+            $master WAIT 1 5000
+            set freed [expire_info_field $slave tair_hash_lazyfree_freed_objects]
+
+            $master multi
+            $master exhdel tairhashkey big
+            $master exec
+            $master WAIT 1 5000
+
+            assert_equal 0 [$slave exhexists tairhashkey big]
+            assert_equal 0 [expire_info_field $slave tair_hash_lazyfree_pending_objects]
+            assert_equal $freed [expire_info_field $slave tair_hash_lazyfree_freed_objects]
+        }
+    }
+}
+
+# Enough fields to build a B+tree of several levels in BTREE_MODE (64 entries per
+# leaf, 32 children per inner node), through both the bulk load and the one by one
+# insert/delete paths. The checks hold in every mode.
+start_server {tags {"tairhash expire index"} overrides {bind 0.0.0.0}} {
+    r module load $testmodule active_expire_period 100
+
+    # The value of each field is the rank of its expire, so EXHRANGEBYTTL must
+    # return non-decreasing values, fields sharing an expire may come in any order.
+    proc check_expire_order {key num} {
+        set res [r exhrangebyttl $key 0 1000000 WITHVALUES]
+        assert_equal [expr {$num * 2}] [llength $res]
+        set prev -1
+        foreach {f v} $res {
+            assert {$v >= $prev}
+            set prev $v
+        }
+        assert_equal $num [llength [lsort -unique [dict keys $res]]]
+    }
+
+    test {Bulk insert from EXHMSETEX on a new key} {
+        r del bulkkey
+        set elements {}
+        for {set j 0} {$j < 3000} {incr j} {
+            lappend elements f:$j 1
+        }
+        assert_equal 1 [r exhmsetex bulkkey PX 100000 FIELDS 3000 {*}$elements]
+        check_expire_order bulkkey 3000
+        assert_equal 3000 [r exhlen bulkkey noexp]
+
+        # Update, delete and insert on the tree loaded at once.
+        set first {}
+        for {set j 0} {$j < 500} {incr j} {
+            assert_equal 1 [r exhpexpire bulkkey f:$j 2000]
+            r exhset bulkkey f:$j 0 keepttl
+            lappend first f:$j
+        }
+        for {set j 500} {$j < 1000} {incr j} {
+            assert_equal 1 [r exhdel bulkkey f:$j]
+        }
+        r exhset bulkkey late 2 px 150000
+        check_expire_order bulkkey 2501
+        set res [r exhrangebyttl bulkkey 0 1000000]
+        assert_equal [lsort $first] [lsort [lrange $res 0 499]]
+        assert_equal late [lindex $res end]
+        assert_equal 500 [llength [r exhrangebyttl bulkkey 0 10000]]
+
+        wait_for_condition 50 100 {
+            [r exhlen bulkkey] == 2001
+        } else {
+            fail "fields are not actively expired"
+        }
+        check_expire_order bulkkey 2001
+        assert_equal 2001 [r exhlen bulkkey noexp]
+        assert_equal {} [r exhmget bulkkey f:0 f:499 f:500]
+        r del bulkkey
+    }
+
+    test {Bulk insert from COPY, RESTORE and RDB load} {
+        r del bulkkey bulkcopy bulkrestore
+        set base [expr {[clock milliseconds] + 100000}]
+        for {set j 0} {$j < 2000} {incr j} {
+            r exhset bulkkey f:$j [expr {$j % 10}] pxat [expr {$base + ($j % 10) * 1000}]
+        }
+        for {set j 0} {$j < 1000} {incr j} {
+            r exhset bulkkey noexp:$j v
+        }
+        for {set j 0} {$j < 200} {incr j} {
+            r exhset bulkkey short:$j -1 px 5000
+        }
+        check_expire_order bulkkey 2200
+
+        set keys {bulkkey bulkrestore}
+        assert_equal OK [r restore bulkrestore 0 [r dump bulkkey]]
+        # COPY is only available since Redis 6.2.
+        if {![catch {r copy bulkkey bulkcopy} res]} {
+            assert_equal 1 $res
+            lappend keys bulkcopy
+        }
+        foreach key $keys {
+            check_expire_order $key 2200
+        }
+
+        r debug reload
+        foreach key $keys {
+            check_expire_order $key 2200
+            assert_equal 3200 [r exhlen $key noexp]
+        }
+
+        wait_for_condition 100 100 {
+            [r exhlen bulkkey] == 3000 && [r exhlen bulkrestore] == 3000 && [r exhlen [lindex $keys end]] == 3000
+        } else {
+            fail "fields are not actively expired after reload"
+        }
+        foreach key $keys {
+            check_expire_order $key 2000
+            assert_equal 1 [r exhdel $key f:0]
+            check_expire_order $key 1999
+        }
+        r del bulkkey bulkcopy bulkrestore
+    }
+
+    test {Split and merge with many fields sharing one expire} {
+        r del samekey
+        set pxat [expr {[clock milliseconds] + 100000}]
+        for {set j 0} {$j < 5000} {incr j} {
+            r exhset samekey f:$j 0 pxat $pxat
+        }
+        check_expire_order samekey 5000
+
+        # Leave one field out of ten, the leaves empty and merge all over the tree.
+        set left {}
+        for {set j 0} {$j < 5000} {incr j} {
+            if {$j % 10} {
+                assert_equal 1 [r exhdel samekey f:$j]
+            } else {
+                lappend left f:$j
+            }
+        }
+        check_expire_order samekey 500
+        assert_equal 500 [r exhlen samekey noexp]
+        assert_equal [lsort $left] [lsort [r exhrangebyttl samekey 0 1000000]]
+
+        # Split them again, then move the fields to another shared expire.
+        for {set j 5} {$j < 5000} {incr j 10} {
+            r exhset samekey f:$j 0 pxat $pxat
+            lappend left f:$j
+        }
+        check_expire_order samekey 1000
+        assert_equal [lsort $left] [lsort [r exhrangebyttl samekey 0 1000000]]
+        foreach f [lrange $left 0 499] {
+            assert_equal 1 [r exhpexpire samekey $f 200000]
+        }
+        check_expire_order samekey 1000
+        assert_equal [lsort [lrange $left 500 end]] [lsort [lrange [r exhrangebyttl samekey 0 1000000] 0 499]]
+
+        foreach f $left {
+            assert_equal 1 [r exhpexpire samekey $f 3000]
+        }
+        check_expire_order samekey 1000
+        wait_for_condition 50 100 {
+            [r exists samekey] == 0
+        } else {
+            fail "fields are not actively expired"
+        }
+    }
+}
+
+start_server {tags {"tairhash databases"} overrides {bind 0.0.0.0 databases 64}} {
+    r module load $testmodule active_expire_period 100
+
+    test {Active expire in db 63} {
+        r select 63
+        r del tairhashkey
+        for {set j 0} {$j < 10} {incr j} {
+            r exhset tairhashkey f$j v px 100
+        }
+        r exhset tairhashkey live v
+
+        # db 63 is past the default 16 databases, its expire index and stats only exist
+        # when they are sized from the databases config.
+        wait_for_condition 50 100 {
+            [string match "*db: 63, active_expired_fields: 10,*" [r exhexpireinfo]]
+        } else {
+            fail "fields in db 63 are not actively expired"
+        }
+        assert_equal 1 [r exhlen tairhashkey]
+        assert_equal v [r exhget tairhashkey live]
+        r select 9
+    }
+}
+
+start_server {tags {"tairhash memory pressure"} overrides {bind 0.0.0.0 maxmemory-policy noeviction}} {
+    r module load $testmodule memory_pressure_ratio 50 active_expire_period 1000 active_expire_keys_per_loop 1000 passive_expire_keys_per_loop 3
+
+    proc pressure_info_field {field} {
+        regexp "\r\n$field:(\\d+)" [r exhexpireinfo] -> value
+        return $value
+    }
+
+    test {Expire quotas scale with memory pressure} {
+        r del tairhashkey
+        assert_equal 0 [pressure_info_field tair_hash_memory_pressure_level]
+
+        set value [string repeat x 100]
+        for {set j 0} {$j < 50000} {incr j 1000} {
+            set elements {}
+            for {set i $j} {$i < $j + 1000} {incr i} {
+                lappend elements field:$i $value
+            }
+            r exhmset tairhashkey {*}$elements
+        }
+
+        # Used memory at 80% of maxmemory, above the 50% ratio.
+        r config set maxmemory [expr {[s used_memory] * 5 / 4}]
+        wait_for_condition 50 100 {
+            [pressure_info_field tair_hash_memory_pressure_level] > 0
+        } else {
+            fail "memory pressure level does not rise"
+        }
+        set level [pressure_info_field tair_hash_memory_pressure_level]
+        assert_equal [expr {1000 << $level}] [pressure_info_field tair_hash_effective_active_expire_keys_per_loop]
+        assert_equal [expr {3 << $level}] [pressure_info_field tair_hash_effective_passive_expire_keys_per_loop]
+        assert_equal [expr {1000 >> $level}] [pressure_info_field tair_hash_effective_active_expire_period]
+        assert_match "*memory_pressure_level:$level*" [r info tairhash]
+
+        # Freeing the key brings used memory back below the ratio.
+        r del tairhashkey
+        wait_for_condition 50 100 {
+            [pressure_info_field tair_hash_memory_pressure_level] == 0
+        } else {
+            fail "memory pressure level does not fall back"
+        }
+        assert_equal 1000 [pressure_info_field tair_hash_effective_active_expire_keys_per_loop]
+        assert_equal 3 [pressure_info_field tair_hash_effective_passive_expire_keys_per_loop]
+        assert_equal 1000 [pressure_info_field tair_hash_effective_active_expire_period]
+        r config set maxmemory 0
+    }
+}